@@ -7,10 +7,17 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <time.h>
+
+#include <atomic>
+#include <memory>
 
 #include "udp_record.h"
 #include "message_type.h"
 #include "parking_infrastructure_streams.h"
+#include "uring_ring.h"
+#include "thread_tuning.h"
+#include "metrics/counters.h"
 
 #include "nlohmann/json.hpp"
 
@@ -20,20 +27,225 @@ using json = nlohmann::json;
 #define MAXLINE 30000
 #endif
 
+/// FIFO records held in a Tx queue over all priorities: 256 HIGH, 512 NORMAL and 256 LOW, a
+/// priority's overflow policy kicks in once its share is full. LATEST_VALUE streams add at most
+/// one pending record each
+constexpr size_t tx_buffer_capacity{1024};
+/// maximum number of records drained from a Tx queue and flushed with one sendmmsg call
+constexpr size_t max_tx_batch_size{32};
+/// how long shutdown() lets a tx thread send what is still queued
+constexpr uint32_t default_shutdown_drain_ms{200};
+/// [ms] a localization older than this does the fusion on the receiving side more harm than good
+constexpr uint32_t default_localization_max_age_ms{100};
+/// [ms] a heartbeat older than this no longer shows that its sender is alive
+constexpr uint32_t default_heartbeat_max_age_ms{250};
+
+/// How the rx/tx work of a bridge socket is scheduled.
+enum class ThreadingMode : uint8_t {
+    /// blocking socket with a dedicated rx and tx thread
+    THREADED = 0,
+    /// non-blocking socket serviced by the single BridgeReactor event loop
+    REACTOR = 1
+};
+
+/// Who stamps the receive time of a datagram, see Base::setRxTimestamping().
+enum class RxTimestamping : uint8_t {
+    /// user space reads the clock once the receive call returns
+    NONE = 0,
+    /// SO_TIMESTAMPNS, the kernel stamps the datagram when it enters the network stack
+    SOFTWARE = 1,
+    /// SO_TIMESTAMPING, the NIC's raw hardware stamp while the NIC clock agrees with CLOCK_REALTIME,
+    /// the kernel's otherwise
+    HARDWARE = 2
+};
+
+/// [ns] how far a raw NIC stamp may be from the kernel's software stamp of the same datagram; beyond
+/// that the NIC clock is not kept on CLOCK_REALTIME and the software stamp is used
+constexpr uint64_t max_hardware_stamp_skew_ns{1000000};
+
+/// control buffer of one received datagram, room for a struct scm_timestamping (three timespecs)
+constexpr size_t rx_timestamp_control_size{CMSG_SPACE(3 * sizeof(struct timespec))};
+/// the timestamp plus the SO_RXQ_OVFL drop count
+constexpr size_t rx_control_size{rx_timestamp_control_size + CMSG_SPACE(sizeof(uint32_t))};
+
+/// Kernel settings of a bridge socket, see Base::setSocketTuning().
+struct SocketTuning {
+    /// [bytes] SO_RCVBUF, 0 keeps the system default. SO_RCVBUFFORCE is tried first, it may go
+    /// beyond net.core.rmem_max but needs CAP_NET_ADMIN
+    int receive_buffer_bytes;
+    /// [bytes] SO_SNDBUF, likewise with SO_SNDBUFFORCE and net.core.wmem_max
+    int send_buffer_bytes;
+    /// [us] SO_BUSY_POLL, how long a blocking receive polls the NIC queue before it sleeps; 0 disables
+    int busy_poll_us;
+    /// SO_PRIORITY of sent packets, 0 to 6 without CAP_NET_ADMIN; -1 keeps the default
+    int priority;
+    /// IP_TOS byte of sent packets, e.g. 0xb8 for DSCP EF; -1 keeps the default
+    int tos;
+    /// SO_RXQ_OVFL, counts the datagrams dropped on a full receive buffer (SO_MEMINFO with IO_URING)
+    bool report_rx_overflow;
+};
+
+/// the system defaults, drops on a full receive buffer are counted
+constexpr SocketTuning default_socket_tuning{0, 0, 0, -1, -1, true};
+
+/// System call interface the rx/tx threads of a bridge socket use.
+enum class SocketBackend : uint8_t {
+    /// recvmmsg/sendmmsg, one syscall per batch
+    SYSCALL = 0,
+    /// multishot receive into provided buffers and batched sendmsg submissions, needs Linux 6.0
+    IO_URING = 1
+};
+
 
 class Base {
  public:
     Base();
     bool init(int rx_port, const char* tx_address, int tx_port);
-    virtual void receiveThreadProcess()=0;
-    virtual void transmitThreadProcess()=0;
     bool shutdown();
     virtual ~Base();
 
+    int socketFd() const { return socket_fd_; }
+
+    ///
+    /// @brief Selects the backend of the rx/tx threads, SYSCALL by default. Must be called before init().
+    /// IO_URING falls back to SYSCALL if this build or kernel lacks io_uring support; a
+    /// BridgeReactor always uses SYSCALL.
+    ///
+    void setSocketBackend(SocketBackend backend) { socket_backend_ = backend; }
+    /// Backend in use after init().
+    SocketBackend socketBackend() const { return socket_backend_; }
+
+    ///
+    /// @brief Selects who stamps the receive time of a record. Must be called before init().
+    ///
+    /// Kernel stamps include the time a datagram waited in the socket buffer while the rx thread
+    /// was not running. HARDWARE only yields NIC stamps if rx timestamping is enabled on the
+    /// interface and phc2sys keeps the NIC clock on CLOCK_REALTIME; a stamp further than
+    /// max_hardware_stamp_skew_ns from the software one is not trusted. The IO_URING backend receives
+    /// without control messages and always stamps in user space.
+    ///
+    void setRxTimestamping(RxTimestamping mode) { rx_timestamping_ = mode; }
+    /// Timestamping in use after init(), NONE if the socket option was refused.
+    RxTimestamping rxTimestamping() const { return rx_timestamping_; }
+
+    ///
+    /// @brief Selects buffer sizes, busy polling, packet priority and drop reporting of the
+    /// socket, see SocketTuning. Must be called before init(); refused settings are logged and
+    /// leave the socket as it was.
+    ///
+    void setSocketTuning(const SocketTuning& tuning) { socket_tuning_ = tuning; }
+
+    ///
+    /// @brief Datagrams the kernel dropped because the receive buffer was full, as far as the
+    /// rx thread has seen them. Counted from SO_RXQ_OVFL, the IO_URING backend reads the same
+    /// count with SO_MEMINFO. May be read from any thread.
+    ///
+    uint64_t rxKernelDrops() const { return rx_kernel_drops_.load(std::memory_order_relaxed); }
+
+    ///
+    /// @brief Pins the rx and tx threads to CPUs and selects their scheduling class, see
+    /// ThreadTuning. Must be called before init(); has no effect in REACTOR mode, where the
+    /// BridgeReactor thread does the work.
+    ///
+    void setThreadTuning(const ThreadTuning& rx, const ThreadTuning& tx) {
+        rx_thread_tuning_ = rx;
+        tx_thread_tuning_ = tx;
+    }
+
  protected:
+    /// Switches the socket to O_NONBLOCK for use from an event loop.
+    bool setNonBlocking();
+
+    ///
+    /// @brief Asks the rx thread to return. A receive call blocked on the socket is woken by
+    /// shutdown(SHUT_RD) and returns empty messages from then on.
+    ///
+    void requestRxStop();
+    bool rxStopRequested() const { return rx_stop_requested_.load(std::memory_order_acquire); }
+
+    ///
+    /// @brief Asks the tx thread to return once its queue is empty, or drain_timeout_ms from now
+    /// at the latest. The caller still has to wake the thread from its queue wait.
+    ///
+    void requestTxStop(uint32_t drain_timeout_ms);
+    ///
+    /// @brief Tx thread side. True once the thread should return.
+    ///
+    /// @param idle nothing is queued and no partial batch waits for the socket
+    ///
+    bool txStopDue(bool idle) const;
+
+    ///
+    /// @brief Sends the prepared messages to tx_address_ with as few sendmmsg calls as possible.
+    /// A message the kernel rejects is logged and skipped so the rest of the batch still goes out.
+    ///
+    /// @param flags extra send flags, MSG_DONTWAIT makes a full socket buffer end the call early
+    /// @return number of messages consumed (sent or skipped); less than count only if the
+    /// socket would block, the caller then retries the remainder later. The msg_len of a
+    /// skipped message is left as it was, callers clear it to tell skipped messages apart
+    ///
+    int sendBatch(struct mmsghdr* msgs, unsigned int count, const char* tag, int flags = 0);
+
+    ///
+    /// @brief Creates the io_uring that sendBatch submits to.
+    ///
+    /// @return false if io_uring is unavailable, sendBatch then keeps using sendmmsg
+    ///
+    bool setupTxRing();
+
+    ///
+    /// @brief Receive time of a datagram in metrics::monotonicNowNs() time.
+    ///
+    /// @param msg header the datagram was received with, its control messages carry the kernel stamp
+    /// @param monotonic_now_ns metrics::monotonicNowNs() after the receive call
+    /// @param realtime_now_ns metrics::realtimeNowNs() read together with monotonic_now_ns
+    /// @return the kernel stamp, or monotonic_now_ns if the datagram carries none
+    ///
+    uint64_t rxTimestampNs(const struct msghdr& msg, uint64_t monotonic_now_ns, uint64_t realtime_now_ns) const;
+
+    /// True if received datagrams carry control messages, a timestamp or the overflow count.
+    bool rxControlEnabled() const {
+        return rx_timestamping_ != RxTimestamping::NONE || socket_tuning_.report_rx_overflow;
+    }
+
+    ///
+    /// @brief Counts the datagrams the kernel dropped since the last call, taken from the
+    /// SO_RXQ_OVFL control message of a received datagram.
+    ///
+    /// @param msg header of the newest datagram, the count in it is a running total
+    ///
+    void countRxOverflow(const struct msghdr& msg, metrics::Direction direction);
+    ///
+    /// @brief Same count read with getsockopt(SO_MEMINFO), for receive paths without control
+    /// messages. Costs a syscall, call it once per batch.
+    ///
+    void pollRxOverflow(metrics::Direction direction);
+
     int socket_fd_;
     struct sockaddr_in rx_address_;
     socklen_t ip_address_length_;
     struct sockaddr_in tx_address_;
+
+    SocketBackend socket_backend_;
+    RxTimestamping rx_timestamping_;
+    SocketTuning socket_tuning_;
+    ThreadTuning rx_thread_tuning_;
+    ThreadTuning tx_thread_tuning_;
+    std::atomic<bool> rx_stop_requested_;
+    // metrics::monotonicNowNs() by which the tx thread returns, 0 while it runs
+    std::atomic<uint64_t> tx_stop_deadline_ns_;
+    // only set while the IO_URING backend is in use, owned by the tx thread
+    std::unique_ptr<UringRing> tx_ring_;
+
+ private:
+    int sendBatchUring(struct mmsghdr* msgs, unsigned int count, const char* tag, int flags);
+    bool enableRxTimestamping();
+    bool hardwareStampUsable(const struct timespec& hardware, const struct timespec& software) const;
+    void applySocketTuning();
+    void addRxOverflow(uint32_t total, metrics::Direction direction);
+
+    // running total of the last SO_RXQ_OVFL message, rx thread only
+    uint32_t rx_overflow_total_;
+    std::atomic<uint64_t> rx_kernel_drops_;
 };
 
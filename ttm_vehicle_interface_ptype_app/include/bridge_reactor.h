@@ -0,0 +1,64 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <atomic>
+#include <thread>
+
+#include "mabx_data_udp.h"
+#include "ttm_data_udp.h"
+
+/// datagrams or batches handled per socket and readiness event before the other socket gets its turn
+constexpr int reactor_rx_budget{8};
+
+///
+/// @brief Single-threaded event loop that services both bridge sockets.
+///
+/// Replaces the four rx/tx threads of the THREADED mode. Both sockets are watched with epoll;
+/// whatever one side receives is forwarded and flushed to the other side in the same loop
+/// pass, so no record ever waits for a thread to be scheduled. EPOLLOUT is only watched while
+/// a socket buffer is full.
+///
+/// MabxData and TtmData must have been initialised with ThreadingMode::REACTOR.
+///
+class BridgeReactor {
+ public:
+    BridgeReactor(MabxData& mabx, TtmData& ttm);
+    BridgeReactor(const BridgeReactor&) = delete;
+    BridgeReactor& operator=(const BridgeReactor&) = delete;
+
+    /// Pins and schedules the loop thread, see ThreadTuning. Must be called before init().
+    void setThreadTuning(const ThreadTuning& tuning) { thread_tuning_ = tuning; }
+
+    /// Creates the epoll instance, registers both sockets and starts the loop thread.
+    bool init();
+
+    /// The event loop, runs on the loop thread started by init().
+    void run();
+
+    ///
+    /// @brief Stops receiving on both sockets, sends what is still queued on either side for up
+    /// to drain_timeout_ms and joins the loop thread. Safe to call more than once.
+    ///
+    bool shutdown(uint32_t drain_timeout_ms = default_shutdown_drain_ms);
+
+    ~BridgeReactor();
+
+ private:
+    void flushTx();
+    void drainTx();
+    void watchWritable(int fd, bool blocked, bool& watching);
+
+    MabxData& mabx_;
+    TtmData& ttm_;
+
+    int epoll_fd_;
+    // eventfd in the epoll set that shutdown() uses to wake the loop
+    int stop_fd_;
+    std::atomic<bool> stop_requested_;
+    uint32_t drain_timeout_ms_;
+    bool mabx_watching_writable_;
+    bool ttm_watching_writable_;
+
+    ThreadTuning thread_tuning_;
+    std::thread loop_thread_;
+};
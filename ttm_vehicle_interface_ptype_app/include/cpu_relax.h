@@ -0,0 +1,13 @@
+#pragma once
+
+///
+/// @brief Hint to the CPU that the caller is spin-waiting, keeps the sibling hyperthread and
+/// the memory bus from being hammered while a spin loop polls shared state.
+///
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
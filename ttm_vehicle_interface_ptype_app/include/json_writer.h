@@ -0,0 +1,75 @@
+#pragma once
+
+#include <charconv>
+#include <stddef.h>
+#include <string.h>
+
+///
+/// @brief Writes a flat JSON object of numbers encoded as strings into a caller owned buffer.
+///
+/// This is the wire format of the TTM backend: {"key":"123",...}. The caller writes the keys
+/// in sorted order, which is what json::dump() produced before. Nothing is allocated, a message
+/// that does not fit the buffer marks the writer as overflowed instead.
+///
+class JsonWriter {
+ public:
+    JsonWriter(char* buffer, size_t capacity) : begin_(buffer),
+                                                 position_(buffer),
+                                                 end_(buffer + capacity),
+                                                 first_field_(true),
+                                                 overflow_(false) {
+        append("{", 1);
+    }
+
+    /// Appends "name":"value" with the value printed by std::to_chars.
+    template <size_t NameSize, typename Number>
+    void field(const char (&name)[NameSize], Number value) {
+
+        if (!first_field_) {
+            append(",", 1);
+        }
+        first_field_ = false;
+
+        append("\"", 1);
+        append(name, NameSize - 1);
+        append("\":\"", 3);
+        if (overflow_) {
+            return;
+        }
+
+        auto result = std::to_chars(position_, end_, value);
+        if (result.ec != std::errc()) {
+            overflow_ = true;
+            return;
+        }
+        position_ = result.ptr;
+
+        append("\"", 1);
+    }
+
+    ///
+    /// @brief Closes the object.
+    ///
+    /// @return bytes written, 0 if the message did not fit
+    ///
+    size_t finish() {
+        append("}", 1);
+        return overflow_ ? 0 : (size_t)(position_ - begin_);
+    }
+
+ private:
+    void append(const char* text, size_t length) {
+        if (overflow_ || (size_t)(end_ - position_) < length) {
+            overflow_ = true;
+            return;
+        }
+        memcpy(position_, text, length);
+        position_ += length;
+    }
+
+    char* begin_;
+    char* position_;
+    char* end_;
+    bool first_field_;
+    bool overflow_;
+};
@@ -13,45 +13,239 @@
 #include <mutex>
 #include <netdb.h>
 
-#include <queue>
+#include <vector>
 #include <iostream>
 #include <memory>
 
 #include "base.h"
+#include "tx_queue.h"
+#include "record_reassembler.h"
 #include "udp_record.h"
 #include "message_type.h"
 #include "parking_infrastructure_streams.h"
 #include "ttm_data_udp.h"
+#include "metrics/latency_histogram.h"
+#include "metrics/counters.h"
 
 class TtmData;
 
-class MabxData : public BaseSocket {
+/// number of datagrams pulled from the MABX socket per recvmmsg call
+constexpr size_t default_mabx_rx_batch_size{16};
+/// time spent topping up a partial batch, 0 hands a batch over as soon as one datagram is in.
+/// Only the THREADED rx thread waits, a MSG_DONTWAIT caller never does
+constexpr int default_mabx_rx_batch_timeout_ms{0};
+
+class MabxData : public Base {
  public:
     MabxData();
 
-    bool init(int rx_port, const std::string tx_address, int tx_port);
+    ///
+    /// @brief Connects the TTM side that received MABX records are forwarded to.
+    ///
+    void setPeer(TtmData* ttm);
+
+    ///
+    /// @brief Configures the batched receive path. Must be called before init().
+    ///
+    /// @param batch_size maximum datagrams per recvmmsg call
+    /// @param timeout_ms how long to keep filling a partial batch after the first
+    /// datagram arrived; larger values trade latency for fewer syscalls
+    ///
+    void setRxBatching(size_t batch_size, int timeout_ms);
+
+    ///
+    /// @brief Sends records larger than UDP_RECORD_MAX_DATAGRAM as a series of chunks instead of
+    /// one IP fragmented datagram. On by default, must be called before init().
+    ///
+    void setTxChunking(bool enabled);
+
+    /// Time allowed for all chunks of a record of stream_number to arrive. Must be called before init().
+    void setReassemblyTimeout(uint8_t stream_number, uint32_t timeout_ms);
+    /// Chunked records dropped before they were complete.
+    uint64_t reassemblyDropped() const;
+
+    ///
+    /// @brief Allocates and touches Tx queue pool blocks up front, see RecordPool::prefault().
+    /// Must be called before init() and before the TTM side starts forwarding records.
+    ///
+    void prefaultTxBuffers(size_t blocks_per_class = default_prefault_blocks_per_class);
+
+    ///
+    /// @param mode THREADED starts the rx and tx threads, REACTOR leaves the socket to a BridgeReactor
+    ///
+    bool init(int rx_port, const std::string tx_address, int tx_port,
+              ThreadingMode mode = ThreadingMode::THREADED);
 
     void receiveMabxData();
     void transmitTtmDataToMabx();
 
-    bool takeFirstTxBuffer(UDPRecordBuffer_t& udp_record);
+    ///
+    /// @brief Receives one batch and forwards it to the TTM Tx queue.
+    ///
+    /// @param flags MSG_WAITFORONE to block for the first datagram, MSG_DONTWAIT from an event loop,
+    ///              which also skips topping up a partial batch
+    /// @return datagrams received, <= 0 if none were available
+    ///
+    int receiveMabxBatch(int flags);
+
+    ///
+    /// @brief Sends up to max_tx_batch_size queued records, with their chunks, with one sendmmsg.
+    ///
+    /// @param flags MSG_DONTWAIT from an event loop
+    /// @return records handed to the socket
+    ///
+    size_t transmitTtmBatch(int flags);
+
+    /// True while part of the last batch is waiting for the socket to become writable.
+    bool txBlocked() const;
+
+    bool takeFirstTxBuffer(PooledRecord*& udp_record);
+    size_t takeTxBuffers(PooledRecord** udp_records, size_t max_count);
+    void releaseTxBuffer(PooledRecord* udp_record);
     void pushTxBuffer(const UDPRecordBuffer_t& udp_record);
 
-    bool shutdown();
+    ///
+    /// @brief Producer side of the zero-copy path, a block to decode a record into.
+    /// It must be handed back through pushTxBuffer(PooledRecord*).
+    ///
+    PooledRecord* acquireTxBuffer(size_t payload_size);
+    /// Queues a block from acquireTxBuffer(), ownership moves to the Tx queue.
+    void pushTxBuffer(PooledRecord* udp_record);
+
+    ///
+    /// @brief Selects how the tx thread waits on an empty Tx queue. Must be called before init().
+    ///
+    void setTxWaitMode(TxWaitMode mode,
+                       uint32_t spin_iterations = default_tx_wait_spin_iterations,
+                       int max_sleep_ms = default_tx_wait_max_sleep_ms);
+    TxWakeup::Stats txWakeupStats() const;
+
+    ///
+    /// @brief Selects what happens when the Tx queue is full. Must be called before init().
+    ///
+    void setTxOverflowPolicy(OverflowPolicy policy);
+    /// Records lost to the Tx queue overflow policy or an exhausted record pool.
+    uint64_t txDropped() const;
+
+    ///
+    /// @brief Selects how the Tx queue holds the records of one streamNumber. Heartbeat and
+    /// localization are LATEST_VALUE by default, everything else FIFO. Must be called before init().
+    ///
+    bool setTxStreamPolicy(uint8_t stream_number, QueuePolicy policy);
+    /// Records of LATEST_VALUE streams replaced by a newer one before they were sent.
+    uint64_t txCoalesced() const;
+
+    ///
+    /// @brief Drops records of one streamNumber that waited longer than max_age_ms since they were
+    /// received instead of sending them, see TxQueue::setStreamMaxAge(). Heartbeat and localization
+    /// have a maximum age by default, 0 sends records however old. Must be called before init().
+    ///
+    void setTxStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms);
+    /// Records dropped because they exceeded the maximum age of their stream.
+    uint64_t txExpired() const;
+
+    ///
+    /// @brief Selects the Tx priority of one streamNumber, heartbeats are HIGH, routes LOW and
+    /// everything else NORMAL by default. Must be called before init().
+    ///
+    void setTxStreamPriority(uint8_t stream_number, TxPriority priority);
+    /// Selects how the tx thread serves the priorities, STRICT by default. Must be called before init().
+    void setTxScheduling(TxScheduling scheduling,
+                         const std::array<uint32_t, tx_priority_count>& weights = default_tx_priority_weights);
+    /// Tx queue depth and queueing delay of one priority.
+    TxQueue::PriorityStats txPriorityStats(TxPriority priority) const;
+
+    ///
+    /// @brief TTM -> MABX latency per streamNumber, from TtmData receiving the JSON message of a
+    /// record to the record being handed to the MABX socket. May be read from any thread.
+    ///
+    const metrics::StreamLatencyHistograms& txLatency() const;
+    ///
+    /// @brief Time datagrams waited in the socket buffer before the rx thread picked them up, only
+    /// recorded with kernel rx timestamps, see setRxTimestamping(). May be read from any thread.
+    ///
+    const metrics::LatencyHistogram& rxSocketDelay() const;
+
+    ///
+    /// @brief Stops and joins the rx thread, nothing is forwarded to the TTM side afterwards.
+    /// shutdown() does this too; calling it on both sides first lets each tx thread empty a
+    /// queue that no longer fills.
+    ///
+    void stopReceiving();
+
+    ///
+    /// @brief Stops receiving, lets the tx thread send what is still queued for up to
+    /// drain_timeout_ms, joins it and closes the socket. Safe to call more than once.
+    /// The peer must not be destroyed before both sides are shut down.
+    ///
+    bool shutdown(uint32_t drain_timeout_ms = default_shutdown_drain_ms);
 
     ~MabxData();
 
  private:
-    std::queue<UDPRecordBuffer_t> tx_buffer_;
-    std::mutex tx_buffer_mutex_;
+    void setupRxBatch();
+    void setupTxBatch();
+    void refillBatch();
+    int receiveBatch(size_t first, int flags);
+    void forwardBatch(int msg_count);
+    bool acceptRecord(const PooledRecord* record, size_t msg_size);
+    PooledRecord* reassembleChunk(const PooledRecord* chunk);
+    PooledRecord* takeRxRecord(PooledRecord*& rx_block);
+    void addTxMessage(size_t iov_count, PooledRecord* completed_record);
+    void recordTxLatency(size_t first, size_t count);
+    void countTx(size_t first, size_t count);
+
+    bool setupRxRing();
+    void receiveMabxDataUring();
+    void provideRxBuffer(uint16_t bid);
+
+    size_t rx_batch_size_;
+    int rx_batch_timeout_ms_;
+    // pooled blocks of the TTM Tx queue that the next recvmmsg writes into. They are full size as
+    // the datagram size is unknown up front, so a record that fits a smaller size class is copied
+    // out and the block stays here; at most rx_batch_size_ (uring_rx_buffer_count with IO_URING)
+    // 32 KB blocks are held on the rx side
+    std::vector<PooledRecord*> rx_batch_records_;
+    std::vector<PooledRecord*> rx_batch_forward_;
+    UDPRecordBuffer_t rx_scratch_;
+    std::vector<struct mmsghdr> rx_batch_msgs_;
+    std::vector<struct iovec> rx_batch_iovecs_;
+    // rx_control_size bytes of control messages per datagram, empty without timestamps and overflow counts
+    std::vector<char> rx_batch_control_;
+    metrics::LatencyHistogram rx_socket_delay_;
+
+    // IO_URING backend, owned by the rx thread
+    std::unique_ptr<UringRing> rx_ring_;
+    // pooled block behind each provided buffer id, nullptr while rx_scratch_ stands in for it
+    std::vector<PooledRecord*> rx_ring_records_;
+    std::vector<UringCompletion> rx_ring_completions_;
+
+    // chunks are copied out of their datagram, the rx block is reused right away
+    RecordReassembler reassembler_;
+
+    std::vector<PooledRecord*> tx_batch_;
+    // one message per record or per chunk, each with two iovec slots (chunk header, payload slice)
+    std::vector<struct mmsghdr> tx_batch_msgs_;
+    std::vector<struct iovec> tx_batch_iovecs_;
+    std::vector<UDPRecord_Header> tx_chunk_headers_;
+    // record to release once a message went out, set on the last message of the record only
+    std::vector<PooledRecord*> tx_batch_msg_records_;
+    size_t tx_batch_count_;
+    size_t tx_batch_sent_;
+    bool tx_chunking_;
+    metrics::StreamLatencyHistograms tx_latency_;
+
+    // single producer (the peer's rx thread), single consumer (our tx thread)
+    TxQueue tx_buffer_;
+
+    ThreadingMode threading_mode_;
 
     std::thread rx_thread_;
-    pthread_t rx_thread_native_handle_;
 
     std::thread tx_thread_;
-    pthread_t tx_thread_native_handle_;
 
-    std::unique_ptr<TtmData> ttm_;
+    // not owned
+    TtmData* ttm_;
 };
 
 
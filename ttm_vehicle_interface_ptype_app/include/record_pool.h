@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "udp_record.h"
+#include "spsc_ring.h"
+
+///
+/// @brief A UDP record held in a pool block that is sized for its payload.
+///
+/// The header is the last member so that header and payload are contiguous and the
+/// record can be handed to sendto/sendmmsg as one buffer of wireSize() bytes.
+///
+struct PooledRecord {
+    /// index of the pool size class the block was carved from
+    uint8_t size_class;
+    uint8_t reserved[3];
+    /// payload bytes the block can hold
+    uint32_t capacity;
+    /// [ns] steady clock time the record entered its Tx queue
+    uint64_t queued_ns;
+    /// [ns] steady clock time the datagram or message the record came in was received, 0 if unknown
+    uint64_t received_ns;
+    /// Header of the UDP message, the payload follows directly after it.
+    UDPRecord_Header header;
+
+    unsigned char* payload() { return reinterpret_cast<unsigned char*>(&header) + sizeof(UDPRecord_Header); }
+    const unsigned char* payload() const {
+        return reinterpret_cast<const unsigned char*>(&header) + sizeof(UDPRecord_Header);
+    }
+
+    /// Start of the bytes that go on the wire.
+    void* wireData() { return &header; }
+    /// Header plus streamDataLen, the number of bytes that go on the wire.
+    size_t wireSize() const { return sizeof(UDPRecord_Header) + header.streamDataLen; }
+};
+
+/// payload capacities of the pool size classes, the last class holds any UDP record
+constexpr uint32_t record_pool_class_capacities[] = {64, 256, 1024, 4096, 16384, RACAM_UDP_RECORD_SIZE};
+constexpr size_t record_pool_class_count = sizeof(record_pool_class_capacities) / sizeof(uint32_t);
+
+///
+/// @brief Slab of right-sized record blocks shared by one producer and one consumer.
+///
+/// The producer thread acquires blocks and the consumer thread releases them once sent.
+/// Released blocks travel back to the producer through one SPSC ring per size class, so
+/// neither side ever takes a lock. Blocks are only returned to the heap when the pool is
+/// destroyed or a return ring overflows.
+///
+class RecordPool {
+ public:
+    ///
+    /// @param blocks_per_class how many released blocks each size class keeps for reuse
+    ///
+    explicit RecordPool(size_t blocks_per_class);
+    RecordPool(const RecordPool&) = delete;
+    RecordPool& operator=(const RecordPool&) = delete;
+    ~RecordPool();
+
+    ///
+    /// @brief Producer side. Returns a block that holds at least payload_size bytes.
+    ///
+    /// @return nullptr if payload_size exceeds RACAM_UDP_RECORD_SIZE or the heap is exhausted
+    ///
+    PooledRecord* acquire(size_t payload_size);
+
+    /// Consumer side. Gives a block back once the record has been sent or discarded.
+    void release(PooledRecord* record);
+
+    /// Producer side. Gives back a block the producer discarded itself, e.g. an evicted record.
+    void recycle(PooledRecord* record);
+
+    ///
+    /// @brief Allocates up to blocks_per_class blocks of every size class and writes to all of
+    /// their pages, so the first records do not take a page fault or a trip into malloc. The
+    /// blocks wait in the producer's cache; call it before the producer thread starts.
+    ///
+    void prefault(size_t blocks_per_class);
+
+    /// Blocks currently allocated from the heap, in use or cached.
+    size_t allocatedBlocks() const;
+    /// Bytes currently allocated from the heap, in use or cached.
+    size_t allocatedBytes() const;
+
+ private:
+    struct SizeClass {
+        explicit SizeClass(size_t blocks) : returned(blocks, OverflowPolicy::DROP_NEWEST), allocated(0) {}
+
+        /// blocks released by the consumer, popped by the producer
+        SpscRing<PooledRecord*> returned;
+        /// blocks the producer recycled itself, only touched by the producer
+        std::vector<PooledRecord*> cached;
+        std::atomic<size_t> allocated;
+    };
+
+    static size_t blockSize(uint32_t capacity);
+    static size_t sizeClassFor(size_t payload_size);
+
+    PooledRecord* allocate(size_t size_class);
+    void deallocate(PooledRecord* record);
+
+    size_t blocks_per_class_;
+    std::vector<std::unique_ptr<SizeClass>> size_classes_;
+};
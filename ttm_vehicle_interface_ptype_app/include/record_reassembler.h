@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "udp_record.h"
+#include "stream_registry.h"
+#include "metrics/counters.h"
+
+/// series reassembled at the same time, each holds a whole UDPRecordBuffer_t
+constexpr size_t reassembly_slot_count{4};
+/// time from the first chunk of a series until an incomplete series is dropped
+constexpr uint32_t default_reassembly_timeout_ms{200};
+
+///
+/// @brief Puts chunked UDP records (streamChunks >= 2) back together.
+///
+/// A chunked record is sent as streamChunks datagrams that share the header of the record,
+/// streamChunkIdx numbers them and streamDataLen is the size of each chunk. All chunks but the
+/// last carry UDP_RECORD_CHUNK_SIZE bytes, so a chunk lands at a fixed offset whatever order the
+/// chunks arrive in. Memory is bounded by reassembly_slot_count records allocated up front; a
+/// series that is not complete before its stream's timeout, or that is superseded by a newer
+/// series of the same stream, is dropped. Used by a single rx thread.
+///
+class RecordReassembler {
+ public:
+    ///
+    /// @param direction bridge direction of the records, for the drop counters
+    ///
+    explicit RecordReassembler(metrics::Direction direction);
+
+    /// Timeout of the series of one stream number, default_reassembly_timeout_ms otherwise.
+    void setTimeout(uint8_t stream_number, uint32_t timeout_ms);
+
+    ///
+    /// @brief Adds one chunk.
+    ///
+    /// @param header header of the chunk datagram, streamChunks >= 2
+    /// @param payload streamDataLen bytes of the chunk
+    /// @param now_ms monotonic time in ms
+    /// @return the whole record once its last chunk is in, valid until the next add(); nullptr otherwise
+    ///
+    const UDPRecordBuffer_t* add(const UDPRecord_Header& header, const unsigned char* payload, uint64_t now_ms);
+
+    /// Series dropped because they timed out, were superseded or evicted, or had a malformed chunk.
+    /// May be read from any thread.
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+    struct Slot {
+        bool active;
+        uint32_t stream_ref_index;
+        uint64_t started_ms;
+        uint64_t deadline_ms;
+        uint16_t received_count;
+        uint16_t last_chunk_size;
+        // one bit per chunk index
+        std::array<uint64_t, 4> received;
+        UDPRecordBuffer_t record;
+    };
+
+    Slot* findSlot(const UDPRecord_Header& header, uint64_t now_ms);
+    void drop(Slot& slot);
+
+    std::vector<Slot> slots_;
+    std::array<uint32_t, stream_table_size> timeout_ms_;
+    std::atomic<uint64_t> dropped_;
+    metrics::Direction direction_;
+};
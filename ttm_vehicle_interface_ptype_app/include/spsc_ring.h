@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_relax.h"
+
+/// keeps the producer and consumer indices of a ring on separate cache lines
+constexpr size_t cache_line_size{64};
+
+/// What a full ring does when another element is pushed.
+enum class OverflowPolicy : uint8_t {
+    /// Evict the oldest queued element to make room for the new one.
+    DROP_OLDEST = 0,
+    /// Reject the new element and leave the ring untouched.
+    DROP_NEWEST = 1
+};
+
+///
+/// @brief Bounded single-producer/single-consumer ring.
+///
+/// Every slot carries a sequence number telling whose turn it is, so neither side ever takes a
+/// lock. With DROP_NEWEST a push is wait-free. With DROP_OLDEST the producer claims the oldest
+/// element itself; if the consumer is copying that very element out at the same moment, the
+/// producer waits for that one copy to finish instead of evicting a second element.
+///
+template <typename T>
+class SpscRing {
+ public:
+    /// Outcome of a push.
+    enum class PushResult : uint8_t {
+        /// the element was queued
+        PUSHED = 0,
+        /// the element was queued after evicting the oldest one
+        EVICTED_OLDEST = 1,
+        /// the ring was full and the element was not queued
+        REJECTED = 2
+    };
+
+    ///
+    /// @param capacity number of queued elements, rounded up to a power of two
+    ///
+    explicit SpscRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::DROP_OLDEST);
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// Must be called before the first push.
+    void setOverflowPolicy(OverflowPolicy policy) { policy_ = policy; }
+
+    ///
+    /// @brief Producer side.
+    ///
+    /// @param evicted receives the element removed under DROP_OLDEST, may be null
+    ///
+    PushResult push(const T& value, T* evicted = nullptr);
+
+    /// Consumer side. Returns false if the ring is empty.
+    bool pop(T& value);
+
+    /// Consumer side. Pops up to max_count elements, returns how many were taken.
+    size_t pop(T* values, size_t max_count);
+
+    bool empty() const;
+    /// Snapshot of the number of queued elements, exact only when both sides are idle.
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+    /// Elements lost to the overflow policy since construction.
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t value);
+
+    alignas(cache_line_size) std::atomic<size_t> head_;
+    alignas(cache_line_size) std::atomic<size_t> tail_;
+    alignas(cache_line_size) std::atomic<uint64_t> dropped_;
+
+    alignas(cache_line_size) const size_t capacity_;
+    const size_t mask_;
+    OverflowPolicy policy_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity, OverflowPolicy policy) : head_(0),
+                                                                 tail_(0),
+                                                                 dropped_(0),
+                                                                 capacity_(roundUpToPowerOfTwo(capacity)),
+                                                                 mask_(capacity_ - 1),
+                                                                 policy_(policy),
+                                                                 slots_(new Slot[capacity_]) {
+
+    // slot i is free for the producer when its sequence equals the position about to be written
+    for (size_t i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+typename SpscRing<T>::PushResult SpscRing<T>::push(const T& value, T* evicted) {
+
+    size_t position = tail_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[position & mask_];
+    PushResult result = PushResult::PUSHED;
+
+    while (slot.sequence.load(std::memory_order_acquire) != position) {
+        // the slot still holds the element from one lap ago, the ring is full
+        if (policy_ == OverflowPolicy::DROP_NEWEST) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return PushResult::REJECTED;
+        }
+
+        // claim the oldest element, it lives in the very slot we want to write
+        size_t oldest = position - capacity_;
+        if (head_.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed)) {
+            if (evicted) {
+                *evicted = std::move(slot.value);
+            }
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            result = PushResult::EVICTED_OLDEST;
+            break;
+        }
+
+        // the consumer won the race for it and releases the slot as soon as its copy is done
+        cpuRelax();
+    }
+
+    slot.value = value;
+    slot.sequence.store(position + 1, std::memory_order_release);
+    tail_.store(position + 1, std::memory_order_release);
+
+    return result;
+}
+
+template <typename T>
+bool SpscRing<T>::pop(T& value) {
+
+    size_t position = head_.load(std::memory_order_relaxed);
+
+    while (true) {
+        Slot& slot = slots_[position & mask_];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+        if (sequence != position + 1) {
+            // nothing published at the head yet
+            if (head_.load(std::memory_order_relaxed) == position) {
+                return false;
+            }
+            position = head_.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        // the head is only contended by a producer evicting under DROP_OLDEST
+        if (head_.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+            value = std::move(slot.value);
+            slot.sequence.store(position + capacity_, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+template <typename T>
+size_t SpscRing<T>::pop(T* values, size_t max_count) {
+
+    size_t count = 0;
+    while (count < max_count && pop(values[count])) {
+        ++count;
+    }
+
+    return count;
+}
+
+template <typename T>
+bool SpscRing<T>::empty() const {
+
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SpscRing<T>::size() const {
+
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t head = head_.load(std::memory_order_acquire);
+
+    return tail > head ? tail - head : 0;
+}
+
+template <typename T>
+size_t SpscRing<T>::roundUpToPowerOfTwo(size_t value) {
+
+    size_t power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+
+    return power;
+}
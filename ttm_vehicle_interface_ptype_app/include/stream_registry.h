@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "udp_record.h"
+#include "parking_infrastructure_streams.h"
+
+///
+/// @brief Compile-time handle of one stream declared in parking_infrastructure_streams.h.
+///
+template <typename PayloadType, ParkingInfrastructure::StreamSource_e Source, uint16_t Number, uint16_t Version>
+struct StreamBinding {
+    using Payload = PayloadType;
+    static constexpr ParkingInfrastructure::StreamSource_e source = Source;
+    static constexpr uint16_t number = Number;
+    static constexpr uint16_t version = Version;
+};
+
+/// one slot per value of UDPRecord_Header::streamNumber
+constexpr size_t stream_table_size{256};
+
+/// Binds the stream declared in namespace ns, e.g. BRIDGED_STREAM(Routing::Streams::Vehicle::Request).
+#define BRIDGED_STREAM(ns) \
+    StreamBinding<ns::Payload, ns::STREAM_SOURCE, ns::STREAM_NUMBER, ns::STREAM_VERSION>
+
+///
+/// @brief One registered stream and the codec bound to its Payload type.
+///
+/// @tparam Codec function pointer type of the direction the table is used for
+///
+template <typename Codec>
+struct StreamEntry {
+    bool registered;
+    /// table index, the streamNumber or the TTM msg_type
+    uint16_t key;
+    uint16_t source;
+    uint16_t number;
+    uint16_t version;
+    uint32_t payload_size;
+    const char* name;
+    Codec codec;
+
+    /// True if header belongs to this stream, the payload length is not checked.
+    bool identifies(const UDPRecord_Header& header) const {
+        return registered && header.sourceInfo == source && header.streamNumber == number &&
+               header.streamVersion == version;
+    }
+};
+
+template <typename Binding, typename Codec>
+constexpr StreamEntry<Codec> makeStreamEntry(uint16_t key, const char* name, Codec codec) {
+    return StreamEntry<Codec>{true, key, Binding::source, Binding::number, Binding::version,
+                              (uint32_t)sizeof(typename Binding::Payload), name, codec};
+}
+
+///
+/// @brief Builds a dense table indexed by key, so dispatch is a single array access.
+///
+/// A duplicate or out of range key stops constant evaluation, i.e. fails the build, provided the
+/// result initializes a constexpr variable. A merely const table is initialized at startup instead
+/// and throws there.
+///
+template <size_t Size, typename Codec>
+constexpr std::array<StreamEntry<Codec>, Size> makeStreamTable(std::initializer_list<StreamEntry<Codec>> entries) {
+
+    std::array<StreamEntry<Codec>, Size> table{};
+    for (const StreamEntry<Codec>& entry : entries)
+    {
+        if (entry.key >= Size || table[entry.key].registered) {
+            throw "stream registered twice or key out of range";
+        }
+        table[entry.key] = entry;
+    }
+
+    return table;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+
+///
+/// @brief CPU placement and scheduling class of one bridge thread.
+///
+/// A SCHED_FIFO thread runs until it blocks. The rx threads block in their receive call and the
+/// tx threads in TxWakeup, but a BUSY_SPIN tx thread never does: give it a CPU of its own.
+///
+struct ThreadTuning {
+    /// bit n allows CPU n, 0 keeps the affinity inherited from main
+    uint64_t cpu_mask;
+    /// SCHED_FIFO priority from 1 to 99, 0 keeps SCHED_OTHER
+    int fifo_priority;
+};
+
+/// leaves a thread where and how the kernel schedules it
+constexpr ThreadTuning default_thread_tuning{0, 0};
+
+/// record pool blocks per size class a pre-faulted Tx queue allocates up front, about 3.5 MB
+constexpr size_t default_prefault_blocks_per_class{64};
+
+///
+/// @brief Names a running thread and applies its tuning.
+///
+/// @param name shown by ps/top, at most 15 characters
+/// @return false if the affinity or priority was refused, e.g. SCHED_FIFO without CAP_SYS_NICE
+/// or an RLIMIT_RTPRIO; the thread then keeps running as it was and a warning is logged
+///
+bool applyThreadTuning(std::thread& thread, const ThreadTuning& tuning, const char* name);
+
+///
+/// @brief Locks all current and future pages of the process in RAM and keeps freed heap memory
+/// mapped, so the hot path cannot take a page fault on memory it has used before. Call it before
+/// the bridge objects are created.
+///
+/// @return false if mlockall was refused, it needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+///
+bool lockProcessMemory();
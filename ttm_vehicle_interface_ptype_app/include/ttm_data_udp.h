@@ -10,46 +10,211 @@
 #include <netdb.h>
 #include <limits>
 
-#include <queue>
+#include <vector>
+#include <string>
 #include <iostream>
 #include <memory>
 
 #include "base.h"
+#include "tx_queue.h"
+#include "ttm_json_decoder.h"
+#include "ttm_json_encoder.h"
 #include "udp_record.h"
 #include "message_type.h"
 #include "parking_infrastructure_streams.h"
 #include "mabx_data_udp.h"
+#include "metrics/latency_histogram.h"
+#include "metrics/counters.h"
 
 class MabxData;
 
-class TtmData : public BaseSocket {
+/// room for the longest message udpRecordToJSON() writes, a heartbeat with 20 digit numbers
+constexpr size_t ttm_json_max_message_size{128};
+
+class TtmData : public Base {
  public:
     TtmData();
 
-    bool init(int rx_port, const std::string tx_address, int tx_port);
+    ///
+    /// @brief Connects the MABX side that received TTM messages are forwarded to.
+    ///
+    void setPeer(MabxData* udp);
+
+    ///
+    /// @brief Allocates and touches Tx queue pool blocks up front, see RecordPool::prefault().
+    /// Must be called before init() and before the MABX side starts forwarding records.
+    ///
+    void prefaultTxBuffers(size_t blocks_per_class = default_prefault_blocks_per_class);
+
+    ///
+    /// @param mode THREADED starts the rx and tx threads, REACTOR leaves the socket to a BridgeReactor
+    ///
+    bool init(int rx_port, const std::string tx_address, int tx_port,
+              ThreadingMode mode = ThreadingMode::THREADED);
 
     void receiveTtmData();
     void transmitMabxDataToTtm();
 
-    bool takeFirstTxBuffer(UDPRecordBuffer_t& udp_record);
+    ///
+    /// @brief Receives one TTM message and forwards it to the MABX Tx queue.
+    ///
+    /// @param flags MSG_DONTWAIT from an event loop
+    /// @return message size, <= 0 if none was available
+    ///
+    int receiveTtmMessage(int flags);
+
+    ///
+    /// @brief Encodes up to max_tx_batch_size queued records and sends them with one sendmmsg.
+    ///
+    /// @param flags MSG_DONTWAIT from an event loop
+    /// @return records taken from the queue or messages handed to the socket, 0 if idle
+    ///
+    size_t transmitMabxBatch(int flags);
+
+    /// True while part of the last batch is waiting for the socket to become writable.
+    bool txBlocked() const;
+
+    bool takeFirstTxBuffer(PooledRecord*& udp_record);
+    size_t takeTxBuffers(PooledRecord** udp_records, size_t max_count);
+    void releaseTxBuffer(PooledRecord* udp_record);
     void pushTxBuffer(const UDPRecordBuffer_t& udp_record);
 
-    bool jsonToUdpRecord(const json& json_msg, UDPRecordBuffer_t& parsed_data);
-    json udpRecordToJSON(const UDPRecordBuffer_t& udp_record);
+    ///
+    /// @brief Producer side of the zero-copy path. Returns a pooled block to receive or decode
+    /// a record into; it must be handed back through pushTxBuffer/pushTxBuffers.
+    ///
+    PooledRecord* acquireTxBuffer(size_t payload_size);
+    /// Queues a block from acquireTxBuffer(), ownership moves to the Tx queue.
+    void pushTxBuffer(PooledRecord* udp_record);
+    /// Queues a batch of blocks from acquireTxBuffer() with a single tx thread wakeup.
+    void pushTxBuffers(PooledRecord** udp_records, size_t count);
+
+    ///
+    /// @brief Decodes one TTM message and queues the record on the MABX side.
+    ///
+    /// @param received_ns metrics::monotonicNowNs() when the message was received, 0 if unknown
+    /// @return false if the message was malformed or could not be queued
+    ///
+    bool jsonToUdpRecord(const char* msg, size_t msg_size, uint64_t received_ns);
+
+    ///
+    /// @brief Encodes a record of a stream bridged to the TTM backend, see TtmJsonEncoder.
+    ///
+    /// @param json_data buffer the message is written to, no terminating zero is added
+    /// @return message size, 0 if the record is not bridged, too short or does not fit capacity
+    ///
+    size_t udpRecordToJSON(const PooledRecord& udp_record, char* json_data, size_t capacity);
+
+    ///
+    /// @brief Selects how the tx thread waits on an empty Tx queue. Must be called before init().
+    ///
+    void setTxWaitMode(TxWaitMode mode,
+                       uint32_t spin_iterations = default_tx_wait_spin_iterations,
+                       int max_sleep_ms = default_tx_wait_max_sleep_ms);
+    TxWakeup::Stats txWakeupStats() const;
+
+    ///
+    /// @brief Selects what happens when the Tx queue is full. Must be called before init().
+    ///
+    void setTxOverflowPolicy(OverflowPolicy policy);
+    /// Records lost to the Tx queue overflow policy or an exhausted record pool.
+    uint64_t txDropped() const;
+
+    ///
+    /// @brief Selects how the Tx queue holds the records of one streamNumber. Heartbeat and
+    /// localization are LATEST_VALUE by default, everything else FIFO. Must be called before init().
+    ///
+    bool setTxStreamPolicy(uint8_t stream_number, QueuePolicy policy);
+    /// Records of LATEST_VALUE streams replaced by a newer one before they were sent.
+    uint64_t txCoalesced() const;
 
-    bool shutdown();
+    ///
+    /// @brief Drops records of one streamNumber that waited longer than max_age_ms since they were
+    /// received instead of sending them, see TxQueue::setStreamMaxAge(). Heartbeat and localization
+    /// have a maximum age by default, 0 sends records however old. Must be called before init().
+    ///
+    void setTxStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms);
+    /// Records dropped because they exceeded the maximum age of their stream.
+    uint64_t txExpired() const;
+
+    ///
+    /// @brief Selects the Tx priority of one streamNumber, heartbeats are HIGH, routes LOW and
+    /// everything else NORMAL by default. Must be called before init().
+    ///
+    void setTxStreamPriority(uint8_t stream_number, TxPriority priority);
+    /// Selects how the tx thread serves the priorities, STRICT by default. Must be called before init().
+    void setTxScheduling(TxScheduling scheduling,
+                         const std::array<uint32_t, tx_priority_count>& weights = default_tx_priority_weights);
+    /// Tx queue depth and queueing delay of one priority.
+    TxQueue::PriorityStats txPriorityStats(TxPriority priority) const;
+
+    ///
+    /// @brief MABX -> TTM latency per streamNumber, from MabxData receiving a record to its JSON
+    /// message being handed to the TTM socket. May be read from any thread.
+    ///
+    const metrics::StreamLatencyHistograms& txLatency() const;
+    ///
+    /// @brief Time messages waited in the socket buffer before the rx thread picked them up, only
+    /// recorded with kernel rx timestamps, see setRxTimestamping(). May be read from any thread.
+    ///
+    const metrics::LatencyHistogram& rxSocketDelay() const;
+
+    ///
+    /// @brief Stops and joins the rx thread, nothing is forwarded to the MABX side afterwards.
+    /// shutdown() does this too; calling it on both sides first lets each tx thread empty a
+    /// queue that no longer fills.
+    ///
+    void stopReceiving();
+
+    ///
+    /// @brief Stops receiving, lets the tx thread send what is still queued for up to
+    /// drain_timeout_ms, joins it and closes the socket. Safe to call more than once.
+    /// The peer must not be destroyed before both sides are shut down.
+    ///
+    bool shutdown(uint32_t drain_timeout_ms = default_shutdown_drain_ms);
 
     ~TtmData();
 
  private:
-    std::queue<UDPRecordBuffer_t> tx_buffer_;
-    std::mutex tx_buffer_mutex_;
+    void setupTxBatch();
+    void recordTxLatency(size_t first, size_t count);
+    void countTx(size_t first, size_t count);
+
+    bool setupRxRing();
+    void receiveTtmDataUring();
+
+    char rx_data_[MAXLINE];
+    char rx_control_[rx_control_size];
+    metrics::LatencyHistogram rx_socket_delay_;
+    // only used by the rx thread
+    TtmJsonDecoder json_decoder_;
+
+    // IO_URING backend, owned by the rx thread. Provided buffer bid is the MAXLINE slot at bid * MAXLINE
+    std::unique_ptr<UringRing> rx_ring_;
+    std::vector<char> rx_ring_buffers_;
+    std::vector<UringCompletion> rx_ring_completions_;
+
+    // single producer (the peer's rx thread), single consumer (our tx thread)
+    TxQueue tx_buffer_;
+
+    std::vector<PooledRecord*> tx_batch_;
+    // encoded messages of the batch, slot i starts at i * ttm_json_max_message_size
+    std::vector<char> tx_batch_json_;
+    std::vector<struct mmsghdr> tx_batch_msgs_;
+    std::vector<struct iovec> tx_batch_iovecs_;
+    // streamNumber and receive time of the record behind each message, the record itself is already released
+    std::vector<uint8_t> tx_batch_streams_;
+    std::vector<uint64_t> tx_batch_received_ns_;
+    size_t tx_batch_count_;
+    size_t tx_batch_sent_;
+    metrics::StreamLatencyHistograms tx_latency_;
+
+    ThreadingMode threading_mode_;
 
     std::thread rx_thread_;
-    pthread_t rx_thread_native_handle_;
 
     std::thread tx_thread_;
-    pthread_t tx_thread_native_handle_;
 
-    std::unique_ptr<MabxData> udp_;
+    // not owned
+    MabxData* udp_;
 };
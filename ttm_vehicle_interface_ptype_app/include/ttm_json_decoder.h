@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <tuple>
+
+#include "nlohmann/json.hpp"
+#include "udp_record.h"
+#include "record_pool.h"
+#include "stream_registry.h"
+#include "parking_infrastructure_streams.h"
+
+///
+/// @brief Streaming decoder for the JSON messages of the TTM backend.
+///
+/// Driven by the nlohmann SAX parser, it writes the fields of every infrastructure stream bridged
+/// to MABX into the stream payload structs as their keys arrive, in any key order. The msg_type
+/// picks the stream through a table registered at compile time in ttm_json_decoder.cc. No DOM and no temporary
+/// strings are built, values are converted with std::from_chars and a malformed message is
+/// reported through the return value instead of an exception. One decoder per rx thread.
+///
+class TtmJsonDecoder : public nlohmann::json_sax<nlohmann::json> {
+ public:
+    TtmJsonDecoder();
+
+    ///
+    /// @brief Decodes one TTM message into header() and payload().
+    ///
+    /// @return false if the message is not a JSON object, has an unknown msg_type or lacks a field
+    ///
+    bool decode(const char* msg, size_t msg_size);
+
+    /// message_type of the last decoded message, -1 if it had none.
+    int messageType() const { return msg_type_; }
+    /// Name of the stream the last message was decoded into, nullptr if decode() failed.
+    const char* streamName() const { return stream_name_; }
+    /// Why the last decode() failed.
+    const char* error() const { return error_; }
+
+    /// Header of the decoded record, everything but the tx counters and time is set.
+    const UDPRecord_Header& header() const { return header_; }
+    /// Payload of the decoded record, header().streamDataLen bytes.
+    const void* payload() const { return payload_; }
+
+    /// Copies header and payload into a block that holds at least header().streamDataLen bytes.
+    void writeRecord(PooledRecord& record) const;
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t& s) override;
+    bool string(string_t& val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string& last_token,
+                     const nlohmann::detail::exception& ex) override;
+
+ private:
+    /// Keys of the message object.
+    enum class Field : uint8_t {
+        MSG_TYPE, TIMESTAMP, MEAS_TIME, FRAME, ZONE,
+        X, Y, Z, ROLL, PITCH, YAW,
+        VAR_X, VAR_Y, VAR_Z, VAR_ROLL, VAR_PITCH, VAR_YAW,
+        MODE, N, DEST,
+        NONE
+    };
+
+    /// Keys of a routing waypoint object, which sits under its index as key ("0", "1", ...).
+    enum class WaypointField : uint8_t {
+        INDEX, X, Y, Z, K, SPEED, LANEWIDTH_RIGHT, LANEWIDTH_LEFT,
+        NONE
+    };
+
+    static Field lookupField(const string_t& key);
+    static WaypointField lookupWaypointField(const string_t& key);
+    static uint32_t fieldBit(Field field) { return 1U << static_cast<uint8_t>(field); }
+    static uint8_t waypointFieldBit(WaypointField field) { return (uint8_t)(1U << static_cast<uint8_t>(field)); }
+
+    bool assign(const char* first, const char* last);
+    bool storeField(Field field, const char* first, const char* last);
+    bool storeWaypointField(WaypointField field, const char* first, const char* last);
+    bool finish();
+    bool fail(const char* error);
+
+    // per stream codec: checks the required fields arrived and completes the scratch payload
+    using DecodeFn = bool (TtmJsonDecoder::*)();
+    template <typename Binding> bool decodeStream();
+    bool complete(ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat::Payload& heartbeat);
+    bool complete(ParkingInfrastructure::Localization::Streams::Infrastructure::Localization::Payload& localization);
+    bool complete(ParkingInfrastructure::Routing::Streams::Infrastructure::Routing::Payload& routing);
+
+    template <typename Binding>
+    static constexpr StreamEntry<DecodeFn> bridged(int msg_type, const char* name) {
+        return makeStreamEntry<Binding, DecodeFn>((uint16_t)msg_type, name, &TtmJsonDecoder::decodeStream<Binding>);
+    }
+
+    /// msg_type values are small and dense, one slot each
+    static constexpr size_t message_type_table_size{32};
+    /// infrastructure streams forwarded to MABX, indexed by msg_type; defined constexpr in the .cc
+    static const std::array<StreamEntry<DecodeFn>, message_type_table_size> ttm_streams_;
+
+    static constexpr uint16_t waypoint_capacity =
+        ParkingInfrastructure::Routing::Streams::Infrastructure::Routing::WAYPOINT_ARRAY_SIZE;
+
+    // scratch payloads, one per bridged stream; a field is written into every payload that carries it
+    std::tuple<ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat::Payload,
+               ParkingInfrastructure::Localization::Streams::Infrastructure::Localization::Payload,
+               ParkingInfrastructure::Routing::Streams::Infrastructure::Routing::Payload>
+        payloads_;
+
+    UDPRecord_Header header_;
+    const void* payload_;
+
+    int msg_type_;
+    const char* stream_name_;
+    const char* error_;
+    uint32_t fields_seen_;
+    uint8_t waypoint_fields_seen_[waypoint_capacity];
+
+    // parser position: object depth, nesting inside an ignored value, key awaiting its value
+    int depth_;
+    int skip_depth_;
+    Field field_;
+    int pending_waypoint_;
+    int waypoint_;
+    WaypointField waypoint_field_;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "udp_record.h"
+#include "record_pool.h"
+
+///
+/// @brief Encodes the MABX streams bridged to the TTM backend as TTM JSON messages.
+///
+/// The streams and their codecs are registered at compile time in ttm_json_encoder.cc, a record is
+/// dispatched through a table indexed by its streamNumber.
+///
+class TtmJsonEncoder {
+ public:
+    /// Name of the bridged stream header belongs to, nullptr if the stream is not bridged.
+    static const char* streamName(const UDPRecord_Header& header);
+
+    ///
+    /// @brief Encodes one record.
+    ///
+    /// @param json_data buffer the message is written to, no terminating zero is added
+    /// @param capacity size of json_data
+    /// @return message size, 0 if the stream is not bridged, the record is too short or the
+    ///         message does not fit
+    ///
+    static size_t encode(const PooledRecord& record, char* json_data, size_t capacity);
+};
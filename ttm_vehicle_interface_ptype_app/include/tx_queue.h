@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "udp_record.h"
+#include "record_pool.h"
+#include "spsc_ring.h"
+#include "stream_registry.h"
+#include "tx_wakeup.h"
+#include "metrics/counters.h"
+
+/// How a Tx queue holds the records of one stream.
+enum class QueuePolicy : uint8_t {
+    /// every record is sent, in order; for command-like streams
+    FIFO = 0,
+    /// only the newest unsent record is kept, it replaces one still waiting; for state-like streams
+    LATEST_VALUE = 1
+};
+
+/// streams of one Tx queue that can be LATEST_VALUE
+constexpr size_t max_latest_value_streams{8};
+
+/// Scheduling class of a stream in a Tx queue, lower values go out first.
+enum class TxPriority : uint8_t {
+    /// e.g. heartbeats, the vehicle disables automated parking when they stop
+    HIGH = 0,
+    /// e.g. localization, the default
+    NORMAL = 1,
+    /// e.g. routing, large and not time critical
+    LOW = 2
+};
+constexpr size_t tx_priority_count{3};
+
+/// How pop() picks between the priorities.
+enum class TxScheduling : uint8_t {
+    /// a priority is only served while all higher ones are empty
+    STRICT = 0,
+    /// round robin where each priority takes up to its weight in records per round
+    WEIGHTED = 1
+};
+
+/// records per WEIGHTED round for HIGH, NORMAL and LOW
+constexpr std::array<uint32_t, tx_priority_count> default_tx_priority_weights{{8, 4, 1}};
+/// quarters of a Tx queue's capacity that the rings of HIGH, NORMAL and LOW get
+constexpr std::array<size_t, tx_priority_count> tx_priority_capacity_quarters{{1, 2, 1}};
+
+///
+/// @brief Tx queue of one bridge direction.
+///
+/// Records live in right-sized RecordPool blocks and only their pointers move through the
+/// rings, so a heartbeat costs its 24 header and 16 payload bytes instead of a 32 KB slot.
+/// There is exactly one producer (the peer's rx thread) and one consumer (our tx thread).
+///
+/// Every TxPriority has its own ring, pop() serves them by the TxScheduling so a burst of
+/// routing records cannot hold back a heartbeat. Records of a LATEST_VALUE stream bypass the
+/// rings: each such stream has a single slot the producer swaps its record into, so a stalled
+/// consumer finds one pending update per stream instead of a backlog. Within a priority those
+/// slots go before the FIFO records.
+///
+class TxQueue {
+ public:
+    ///
+    /// @param capacity FIFO records held over all priorities, split by tx_priority_capacity_quarters;
+    ///                 the overflow policy applies per priority once its share is full
+    /// @param direction bridge direction of the records, for the drop counters
+    ///
+    TxQueue(size_t capacity, metrics::Direction direction);
+    TxQueue(const TxQueue&) = delete;
+    TxQueue& operator=(const TxQueue&) = delete;
+    ~TxQueue();
+
+    /// Must be called before the first push.
+    void setOverflowPolicy(OverflowPolicy policy);
+    /// Must be called before the consumer starts waiting.
+    void setWaitMode(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms);
+
+    ///
+    /// @brief Selects the queue policy of the records with this streamNumber, FIFO by default.
+    /// Must be called before the first push.
+    ///
+    /// @return false if max_latest_value_streams streams are LATEST_VALUE already
+    ///
+    bool setStreamPolicy(uint8_t stream_number, QueuePolicy policy);
+
+    /// Selects the priority of the records with this streamNumber, NORMAL by default. Must be called before the first push.
+    void setStreamPriority(uint8_t stream_number, TxPriority priority);
+
+    ///
+    /// @brief Records of this streamNumber older than max_age_ms when they are popped are dropped
+    /// instead of sent. The age counts from received_ns, or from queued_ns for a record without
+    /// one. 0, the default, sends records however old. Must be called before the first pop.
+    ///
+    void setStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms);
+
+    ///
+    /// @brief Selects how pop() serves the priorities, STRICT by default. Must be called before the first pop.
+    ///
+    /// @param weights records per round of HIGH, NORMAL and LOW for WEIGHTED, at least 1 each
+    ///
+    void setScheduling(TxScheduling scheduling,
+                       const std::array<uint32_t, tx_priority_count>& weights = default_tx_priority_weights);
+
+    /// Queue depth and queueing delay of one priority.
+    struct PriorityStats {
+        /// records waiting, a snapshot
+        size_t depth;
+        /// records taken by the consumer
+        uint64_t dequeued;
+        /// [ns] push to pop, for the last record
+        uint64_t last_wait_ns;
+        /// [ns] worst push to pop seen so far
+        uint64_t max_wait_ns;
+        /// [ns] sum over all dequeued records, divide by dequeued for the mean
+        uint64_t total_wait_ns;
+    };
+    PriorityStats priorityStats(TxPriority priority) const;
+
+    ///
+    /// @brief Producer side. Copies the header and streamDataLen payload bytes into a pool
+    /// block and queues it.
+    ///
+    /// @return false if the record was dropped
+    ///
+    bool push(const UDPRecordBuffer_t& udp_record);
+
+    /// Producer side. Returns a block to fill in place before handing it to push().
+    PooledRecord* acquire(size_t payload_size);
+
+    /// Producer side. Queues a block from acquire(), the queue owns it from here on.
+    bool push(PooledRecord* record);
+
+    /// Producer side. Queues a batch of blocks from acquire() with a single consumer wakeup.
+    size_t push(PooledRecord** records, size_t count);
+
+    /// Consumer side. Takes up to max_count records in scheduling order, each must be handed to release().
+    size_t pop(PooledRecord** records, size_t max_count);
+
+    /// Consumer side. Returns a popped record to the pool once it has been sent.
+    void release(PooledRecord* record);
+
+    /// Consumer side. Blocks according to the wait mode until a record may be available.
+    bool wait();
+
+    /// Wakes the consumer and makes every later wait() return at once, used to stop the tx thread.
+    void interruptWait();
+
+    bool empty() const;
+    /// Records lost to the overflow policy or to an exhausted pool.
+    uint64_t dropped() const;
+    /// Records of LATEST_VALUE streams replaced by a newer one before they were sent.
+    uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+    /// Records dropped at pop() because they exceeded the maximum age of their stream.
+    uint64_t expired() const { return expired_.load(std::memory_order_relaxed); }
+    TxWakeup::Stats wakeupStats() const { return wakeup_.stats(); }
+    const RecordPool& pool() const { return pool_; }
+    /// Producer side, see RecordPool::prefault().
+    void prefault(size_t blocks_per_class) { pool_.prefault(blocks_per_class); }
+
+ private:
+    struct PriorityCounters {
+        std::atomic<uint64_t> dequeued;
+        std::atomic<uint64_t> last_wait_ns;
+        std::atomic<uint64_t> max_wait_ns;
+        std::atomic<uint64_t> total_wait_ns;
+    };
+
+    bool enqueue(PooledRecord* record);
+    bool enqueue(const UDPRecordBuffer_t& udp_record);
+    size_t popPriority(size_t priority, PooledRecord** records, size_t max_count, uint64_t now_ns);
+    size_t dropExpired(PooledRecord** records, size_t count, uint64_t now_ns);
+
+    RecordPool pool_;
+    // one FIFO ring per TxPriority
+    std::vector<std::unique_ptr<SpscRing<PooledRecord*>>> rings_;
+    TxWakeup wakeup_;
+    std::atomic<bool> wait_interrupted_;
+    std::atomic<uint64_t> rejected_;
+    metrics::Direction direction_;
+
+    TxScheduling scheduling_;
+    std::array<uint32_t, tx_priority_count> weights_;
+    std::array<uint8_t, stream_table_size> stream_priorities_;
+    // [ns] 0 for streams without a maximum age
+    std::array<uint64_t, stream_table_size> stream_max_age_ns_;
+    bool any_max_age_;
+
+    static constexpr uint8_t fifo_stream{0xff};
+    // latest value slot of each streamNumber, fifo_stream for FIFO streams
+    std::array<uint8_t, stream_table_size> stream_slots_;
+    // streamNumber of each latest value slot
+    std::array<uint8_t, max_latest_value_streams> latest_streams_;
+    std::array<std::atomic<PooledRecord*>, max_latest_value_streams> latest_;
+    size_t latest_count_;
+    std::atomic<uint64_t> coalesced_;
+    std::atomic<uint64_t> expired_;
+
+    // written by the consumer only
+    std::array<PriorityCounters, tx_priority_count> priority_counters_;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include "cpu_relax.h"
+
+/// How a tx thread waits for its queue to fill.
+enum class TxWaitMode : uint8_t {
+    /// Never sleep, poll the queue continuously (lowest latency, one core at 100%).
+    BUSY_SPIN = 0,
+    /// Spin for a bounded number of iterations, then sleep until a producer signals.
+    HYBRID = 1,
+    /// Sleep as soon as the queue is empty.
+    BLOCKING = 2
+};
+
+/// spin iterations before a HYBRID waiter goes to sleep
+constexpr uint32_t default_tx_wait_spin_iterations{2000};
+/// upper bound on a single sleep, a safety net in case a producer never signals
+constexpr int default_tx_wait_max_sleep_ms{100};
+
+///
+/// @brief Spin-then-sleep wakeup between the producers of a Tx queue and its tx thread.
+///
+/// The waiter announces that it is going to sleep before it re-checks the queue, so a
+/// producer that publishes a record and then calls notify() can never be missed. Producers
+/// only pay for the eventfd write while the waiter is actually asleep.
+///
+class TxWakeup {
+ public:
+    /// Counters describing how the tx thread has been waiting.
+    struct Stats {
+        /// times the waiter went to sleep on the eventfd
+        uint64_t sleeps;
+        /// sleeps that were ended by a producer
+        uint64_t wakeups;
+        /// sleeps that ended on the max sleep timeout
+        uint64_t timeouts;
+        /// [ns] notify() to waiter running again, for the last wakeup
+        uint64_t last_latency_ns;
+        /// [ns] worst notify() to waiter running again seen so far
+        uint64_t max_latency_ns;
+        /// [ns] sum over all wakeups, divide by wakeups for the mean
+        uint64_t total_latency_ns;
+    };
+
+    TxWakeup();
+    TxWakeup(const TxWakeup&) = delete;
+    TxWakeup& operator=(const TxWakeup&) = delete;
+    ~TxWakeup();
+
+    ///
+    /// @brief Selects the wait strategy. Must be called before the tx thread starts waiting.
+    ///
+    /// @param spin_iterations how long a HYBRID waiter polls before sleeping
+    /// @param max_sleep_ms upper bound on a single sleep
+    ///
+    void configure(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms);
+
+    ///
+    /// @brief Producer side. Call after the record is visible to the consumer.
+    ///
+    void notify();
+
+    ///
+    /// @brief Consumer side. Waits until has_data() returns true or the max sleep expires.
+    ///
+    /// @return the last result of has_data()
+    ///
+    template <typename Predicate>
+    bool wait(Predicate has_data);
+
+    Stats stats() const;
+
+    /// The eventfd that becomes readable on notify(), for callers that poll it themselves.
+    int fd() const { return event_fd_; }
+
+ private:
+    void sleep();
+    void cancelSleep();
+    void drain();
+
+    int event_fd_;
+    TxWaitMode mode_;
+    uint32_t spin_iterations_;
+    int max_sleep_ms_;
+
+    std::atomic<bool> sleeping_;
+    std::atomic<uint64_t> notify_time_ns_;
+
+    std::atomic<uint64_t> sleeps_;
+    std::atomic<uint64_t> wakeups_;
+    std::atomic<uint64_t> timeouts_;
+    std::atomic<uint64_t> last_latency_ns_;
+    std::atomic<uint64_t> max_latency_ns_;
+    std::atomic<uint64_t> total_latency_ns_;
+};
+
+template <typename Predicate>
+bool TxWakeup::wait(Predicate has_data) {
+
+    uint32_t spins = 0;
+    if (mode_ == TxWaitMode::HYBRID) {
+        spins = spin_iterations_;
+    }
+
+    for (uint32_t i = 0; mode_ == TxWaitMode::BUSY_SPIN || i < spins; ++i) {
+        if (has_data()) {
+            return true;
+        }
+        cpuRelax();
+    }
+
+    // announce the sleep before the final check, pairs with the fence in notify()
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (has_data()) {
+        cancelSleep();
+        return true;
+    }
+
+    sleep();
+    sleeping_.store(false, std::memory_order_relaxed);
+
+    return has_data();
+}
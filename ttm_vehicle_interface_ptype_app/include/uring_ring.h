@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/// provided receive buffers per socket, each holds one datagram until its completion is handled
+constexpr uint16_t uring_rx_buffer_count{64};
+/// longest a rx thread blocks in io_uring_enter before it checks for cancellation
+constexpr int uring_rx_wait_timeout_ms{100};
+
+/// One completion taken from the ring, decoded from the kernel's io_uring_cqe.
+struct UringCompletion {
+    uint64_t user_data;
+    /// bytes transferred, or -errno
+    int32_t res;
+    /// the request is still armed and will complete again (multishot)
+    bool more;
+    /// the kernel picked a provided buffer, buffer_id tells which one
+    bool has_buffer;
+    uint16_t buffer_id;
+};
+
+///
+/// @brief Minimal io_uring instance bound to one socket, driven with raw syscalls.
+///
+/// The socket is registered as fixed file so requests skip the per-call file lookup. Receives
+/// use one multishot request that keeps completing into buffers of a registered buffer ring,
+/// sends are batched sendmsg requests submitted with a single io_uring_enter. Each ring is used
+/// by exactly one thread. Without TTM_HAVE_IO_URING at build time init() always fails, so
+/// callers fall back to the recvmmsg/sendmmsg path.
+///
+class UringRing {
+ public:
+    UringRing();
+    UringRing(const UringRing&) = delete;
+    UringRing& operator=(const UringRing&) = delete;
+    ~UringRing();
+
+    ///
+    /// @brief Creates the ring and registers socket_fd with it.
+    ///
+    /// @param sq_entries submission queue size
+    /// @param cq_entries completion queue size, 0 leaves it at twice sq_entries
+    /// @return false if io_uring is not available in this build or kernel
+    ///
+    bool init(int socket_fd, unsigned sq_entries, unsigned cq_entries = 0);
+
+    ///
+    /// @brief Registers a ring of provided receive buffers, needed by waitReceive().
+    ///
+    /// @param entries buffer ids 0..entries-1, must be a power of two
+    ///
+    bool setupBufferRing(uint16_t entries);
+
+    /// Hands buffer bid (back) to the kernel, visible once commitBuffers() is called.
+    void provideBuffer(void* addr, uint32_t length, uint16_t bid);
+    /// Publishes all buffers provided since the last commit.
+    void commitBuffers();
+
+    ///
+    /// @brief Queues a sendmsg of msg, submitted by the next submit().
+    ///
+    /// @param link the next request queued starts only once this one has succeeded, and is
+    ///        cancelled with -ECANCELED if it fails
+    /// @return false if the submission queue is full
+    ///
+    bool prepareSendMsg(const struct msghdr* msg, int flags, uint64_t user_data, bool link = false);
+
+    /// Drops queued requests the kernel has not taken yet, e.g. after submit() failed.
+    void discardUnsubmitted();
+
+    ///
+    /// @brief Submits queued requests and waits for completions.
+    ///
+    /// @param wait_count completions to wait for, 0 only submits
+    /// @param timeout_ms upper bound on the wait, < 0 waits indefinitely
+    /// @return requests submitted or -errno, -ETIME if the timeout expired
+    ///
+    int submit(unsigned wait_count, int timeout_ms = -1);
+
+    /// Takes up to max_count completions off the completion queue without blocking.
+    unsigned takeCompletions(UringCompletion* completions, unsigned max_count);
+
+    ///
+    /// @brief Waits for datagrams of the multishot receive, re-arming it whenever the kernel
+    /// terminates it, e.g. because the buffer ring ran dry.
+    ///
+    /// @return completions that carry a datagram, 0 on timeout, -1 if this kernel does not
+    /// support multishot receive
+    ///
+    int waitReceive(UringCompletion* completions, unsigned max_count, int timeout_ms);
+
+    /// Times the buffer ring ran dry and the receive had to be re-armed, datagrams wait in the socket meanwhile.
+    uint64_t bufferExhaustedCount() const { return buffer_exhausted_; }
+
+ private:
+    void armReceive();
+    struct io_uring_sqe* nextSqe();
+
+    int ring_fd_;
+    void* ring_memory_;
+    size_t ring_memory_size_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    // sqes handed out by nextSqe(), published to sq_tail_ by submit()
+    unsigned sqe_tail_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    struct io_uring_buf_ring* buffer_ring_;
+    size_t buffer_ring_size_;
+    uint16_t buffer_mask_;
+    uint16_t buffer_tail_;
+
+    bool receive_armed_;
+    bool receive_completed_;
+    uint64_t buffer_exhausted_;
+};
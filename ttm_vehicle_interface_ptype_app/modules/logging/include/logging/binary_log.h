@@ -0,0 +1,229 @@
+#pragma once
+
+#include "logging/binary_log_format.h"
+#include "logging/log_level.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace logging {
+
+  /// bytes of the lock-free ring of each logging thread
+  constexpr size_t binary_log_ring_bytes{64 * 1024};
+  /// largest record of one BLOG statement, arguments that do not fit are left out
+  constexpr size_t binary_log_max_record_size{1024};
+  /// how often the writer thread drains the rings
+  constexpr uint32_t binary_log_flush_interval_ms{20};
+  /// size at which the log file is rotated, see BinaryLog::start()
+  constexpr size_t binary_log_default_max_file_bytes{64 * 1024 * 1024};
+
+  ///
+  /// @brief Static part of a BLOG statement, written to the log once instead of with every record.
+  ///
+  struct BinaryLogSite
+  {
+    BinaryLogSite(const char* file, uint32_t line, uint8_t level, const char* format);
+
+    const char* file;
+    uint32_t line;
+    uint8_t level;
+    /// message with a {} for each argument
+    const char* format;
+    uint32_t id;
+  };
+
+  class BinaryLogRing;
+
+  ///
+  /// @brief Binary log backend: BLOG statements copy their site id and raw argument bytes into a
+  /// lock-free ring of the calling thread, a writer thread moves the records to a file and
+  /// binary_log_decode turns the file into text. Nothing is formatted on the logging thread.
+  ///
+  class BinaryLog
+  {
+    public:
+      BinaryLog(const BinaryLog&) = delete;
+      void operator=(const BinaryLog&) = delete;
+
+      static BinaryLog& getInstance();
+
+      ///
+      /// @brief Creates the log file and starts the writer thread. BLOG statements are
+      /// ignored until start() is called.
+      ///
+      /// Once the file reaches max_file_bytes it is renamed to <file_path>.1, replacing the
+      /// previous one, and a new file is started, so the log takes about twice max_file_bytes
+      /// on disk at most. Each file decodes on its own.
+      ///
+      /// @return false if the file could not be created
+      ///
+      bool start(const std::string& file_path, size_t max_file_bytes = binary_log_default_max_file_bytes);
+
+      ///
+      /// @brief Writes the records still in the rings and closes the file.
+      ///
+      void stop();
+
+      /// Records lost because the ring of their thread was full.
+      uint64_t droppedRecords() const;
+
+      /// Called by BLOG, see there.
+      template <typename... Args>
+      static void record(const BinaryLogSite& site, const Args&... args);
+
+      /// Called by BinaryLogSite, sites are numbered in the order they are first reached.
+      uint32_t registerSite(const BinaryLogSite* site);
+
+    private:
+      BinaryLog();
+      ~BinaryLog();
+
+      static constexpr size_t record_header_size{sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint64_t)};
+
+      static void commit(const BinaryLogSite& site, uint8_t* record, size_t size);
+      BinaryLogRing* registerThread();
+      void writeLoop();
+      bool drain();
+      void writeSites(size_t count);
+      void writeEntry();
+      bool openFile();
+      void rotateIfFull(size_t site_count);
+
+      static std::atomic<bool> enabled_;
+
+      mutable std::mutex mutex_;
+      std::vector<const BinaryLogSite*> sites_;
+      std::vector<BinaryLogRing*> rings_;
+
+      std::string file_path_;
+      size_t max_file_bytes_;
+
+      // owned by the writer thread while it runs
+      FILE* file_;
+      size_t file_bytes_;
+      size_t file_records_;
+      size_t sites_written_;
+      std::vector<uint8_t> entry_;
+
+      std::condition_variable stop_condition_;
+      bool stopping_;
+      std::thread writer_thread_;
+  };
+
+namespace binary_log {
+
+  template <typename T>
+  inline uint8_t* encodeValue(uint8_t* out, const uint8_t* end, ArgType type, T value)
+  {
+    if (out + 1 + sizeof(value) > end)
+    {
+      return out;
+    }
+    *out = static_cast<uint8_t>(type);
+    memcpy(out + 1, &value, sizeof(value));
+    return out + 1 + sizeof(value);
+  }
+
+  inline uint8_t* encodeString(uint8_t* out, const uint8_t* end, const char* text, size_t size)
+  {
+    if (out + 1 + sizeof(uint16_t) > end)
+    {
+      return out;
+    }
+
+    size_t room = (size_t)(end - out) - 1 - sizeof(uint16_t);
+    uint16_t length = (uint16_t)std::min(std::min(size, max_string_arg_size), room);
+    *out = static_cast<uint8_t>(ArgType::STRING);
+    memcpy(out + 1, &length, sizeof(length));
+    memcpy(out + 1 + sizeof(length), text, length);
+    return out + 1 + sizeof(length) + length;
+  }
+
+  template <typename T>
+  struct unsupported_arg : std::false_type {};
+
+  ///
+  /// @brief Appends the type tag and raw bytes of one BLOG argument, nothing if it does not fit.
+  ///
+  template <typename T>
+  inline uint8_t* encodeArg(uint8_t* out, const uint8_t* end, const T& arg)
+  {
+    if constexpr (std::is_enum_v<T>)
+    {
+      return encodeArg(out, end, static_cast<std::underlying_type_t<T>>(arg));
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+      return sizeof(T) <= 4 ? encodeValue(out, end, ArgType::INT32, (int32_t)arg)
+                            : encodeValue(out, end, ArgType::INT64, (int64_t)arg);
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+      return sizeof(T) <= 4 ? encodeValue(out, end, ArgType::UINT32, (uint32_t)arg)
+                            : encodeValue(out, end, ArgType::UINT64, (uint64_t)arg);
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+      return encodeValue(out, end, ArgType::DOUBLE, (double)arg);
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+      return encodeString(out, end, arg.data(), arg.size());
+    }
+    else if constexpr (std::is_convertible_v<const T&, const char*>)
+    {
+      const char* text = arg;
+      return text ? encodeString(out, end, text, strlen(text)) : encodeString(out, end, "(null)", 6);
+    }
+    else if constexpr (std::is_pointer_v<T>)
+    {
+      return encodeValue(out, end, ArgType::UINT64, (uint64_t)(uintptr_t)arg);
+    }
+    else
+    {
+      static_assert(unsupported_arg<T>::value, "BLOG arguments must be numbers, enums, strings or pointers");
+      return out;
+    }
+  }
+
+};
+
+  template <typename... Args>
+  void BinaryLog::record(const BinaryLogSite& site, const Args&... args)
+  {
+    if (!enabled_.load(std::memory_order_relaxed))
+    {
+      return;
+    }
+
+    uint8_t record[binary_log_max_record_size];
+    uint8_t* out = record + record_header_size;
+    [[maybe_unused]] const uint8_t* end = record + sizeof(record);
+    ((out = binary_log::encodeArg(out, end, args)), ...);
+
+    commit(site, record, (size_t)(out - record));
+  }
+};
+
+///
+/// @brief Logs to the binary log, e.g.
+/// BLOG(INFO, "MUDP - Received {} of {} bytes", stream_name, size);
+/// The format must be a string literal, each {} is replaced by the next argument when the log
+/// is decoded. Statements below LOGGING_MIN_LEVEL compile to nothing, like LOG.
+///
+#define BLOG(level, format, ...) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else logging::BinaryLog::record( \
+         []() -> const logging::BinaryLogSite& { \
+           static const logging::BinaryLogSite logging_site(__FILE__, __LINE__, LOGGING_LEVEL_ID(level), format); \
+           return logging_site; }() \
+         , ##__VA_ARGS__)
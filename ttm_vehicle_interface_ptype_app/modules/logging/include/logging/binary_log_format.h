@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+///
+/// Layout of the files BinaryLog writes, shared with the binary_log_decode tool. All integers
+/// are in host byte order, a file is decoded on a machine of the same endianness.
+///
+/// file   := magic entry*
+/// entry  := SITE   id:u32 level:u8 line:u32 file_len:u16 file format_len:u16 format
+///         | RECORD site:u32 thread:u32 time_ns:u64 args_len:u16 arg*
+///         | DROPS  thread:u32 count:u64
+/// arg    := type:u8 value, value is 4 or 8 bytes, or len:u16 bytes for STRING
+///
+/// A SITE entry comes before the first RECORD that refers to it.
+///
+namespace logging {
+namespace binary_log {
+
+  constexpr char file_magic[8] = {'T', 'T', 'M', 'B', 'L', 'O', 'G', '1'};
+
+  enum class EntryType : uint8_t
+  {
+    SITE = 1,
+    RECORD = 2,
+    /// records a thread lost because its ring was full
+    DROPS = 3
+  };
+
+  enum class ArgType : uint8_t
+  {
+    INT32 = 1,
+    UINT32 = 2,
+    INT64 = 3,
+    UINT64 = 4,
+    DOUBLE = 5,
+    STRING = 6
+  };
+
+  /// longest STRING argument, longer strings are cut
+  constexpr size_t max_string_arg_size{256};
+
+};
+};
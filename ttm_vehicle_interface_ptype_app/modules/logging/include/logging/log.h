@@ -4,6 +4,7 @@
 
 #include "logging/standard_output_sink.h"
 #include "logging/additional_logging_levels.h"
+#include "logging/log_level.h"
 
 #include <string>
 #include <memory>
@@ -25,7 +26,10 @@ namespace logging {
       /// LOG(...) calls. It's recommended to add this as the first line in the 
       /// top level application's main() function.
       ///
-      static void initialize();
+      /// @param standard_output_mode how log lines are written to the terminal, only
+      /// takes effect on the first call
+      ///
+      static void initialize(StandardOutputMode standard_output_mode = StandardOutputMode::IMMEDIATE);
 
       ///
       /// @brief returns a reference to the Logger singleton, through which, changes 
@@ -47,9 +51,17 @@ namespace logging {
       /// 
       void enableFileOutput(std::string prefix, std::string file_path);
 
+      ///
+      /// @brief Lines the standard output sink dropped because the terminal could not keep
+      /// up, see StandardOutputMode::BUFFERED.
+      ///
+      uint64_t droppedStandardOutputLines();
+
     private:
       Logger();
 
+      static StandardOutputMode standard_output_mode_;
+
       bool file_output_enabled_ = true;
       bool standard_output_enabled_ = true;
       std::unique_ptr<g3::LogWorker> log_worker_;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "logging/additional_logging_levels.h"
+
+#include <g3log/g3log.hpp>
+
+// Numeric id of each level, to compare levels in the preprocessor and in constant expressions.
+// G3LOG_DEBUG is what DEBUG expands to when it is passed on through another macro.
+#define LOGGING_LEVEL_ID_DEBUG 0
+#define LOGGING_LEVEL_ID_G3LOG_DEBUG 0
+#define LOGGING_LEVEL_ID_INFO 1
+#define LOGGING_LEVEL_ID_WARNING 2
+#define LOGGING_LEVEL_ID_ERROR 3
+#define LOGGING_LEVEL_ID_FATAL 4
+
+///
+/// Lowest level that is compiled in, set by the LOGGING_MIN_LEVEL CMake option of the logging
+/// target. Statements of lower levels compile to nothing, their stream arguments included.
+///
+#ifndef LOGGING_MIN_LEVEL
+#define LOGGING_MIN_LEVEL LOGGING_LEVEL_ID_DEBUG
+#endif
+
+#define LOGGING_LEVEL_ID(level) LOGGING_LEVEL_ID_##level
+#define LOGGING_COMPILED_IN(level) (LOGGING_LEVEL_ID(level) >= LOGGING_MIN_LEVEL)
+
+// g3log builds the message of a statement below the minimum level and only then filters it,
+// these versions of its macros discard the statement at compile time instead
+#undef LOG
+#undef LOG_IF
+#undef LOGF
+#undef LOGF_IF
+
+#define LOG(level) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (!g3::logLevel(level)) {} \
+  else INTERNAL_LOG_MESSAGE(level).stream()
+
+#define LOG_IF(level, boolean_expression) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (false == (boolean_expression) || !g3::logLevel(level)) {} \
+  else INTERNAL_LOG_MESSAGE(level).stream()
+
+#define LOGF(level, printf_like_message, ...) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (!g3::logLevel(level)) {} \
+  else INTERNAL_LOG_MESSAGE(level).capturef(printf_like_message, ##__VA_ARGS__)
+
+#define LOGF_IF(level, boolean_expression, printf_like_message, ...) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (false == (boolean_expression) || !g3::logLevel(level)) {} \
+  else INTERNAL_LOG_MESSAGE(level).capturef(printf_like_message, ##__VA_ARGS__)
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "logging/log.h"
+#include "logging/binary_log.h"
+
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+#include <time.h>
+
+namespace logging {
+
+  /// interval of the LOG_EVERY_MS statements on per-packet paths
+  constexpr uint32_t default_log_interval_ms{1000};
+
+  ///
+  /// @brief Occurrences of a log statement that one emitted line stands for.
+  /// Converts to false for an occurrence that is not logged.
+  ///
+  struct LogSiteSummary
+  {
+    uint64_t occurrences;
+
+    explicit operator bool() const { return occurrences != 0; }
+  };
+
+  /// Prefixes the line with the number of occurrences it stands for, nothing for a single one.
+  inline std::ostream& operator<<(std::ostream& stream, const LogSiteSummary& summary)
+  {
+    if (summary.occurrences > 1)
+    {
+      stream << "[x" << summary.occurrences << "] ";
+    }
+    return stream;
+  }
+
+  ///
+  /// @brief State of one LOG_EVERY_N statement: logs the first of every n occurrences.
+  ///
+  class EveryNLogSite
+  {
+    public:
+      explicit EveryNLogSite(uint32_t n) : n_(n > 0 ? n : 1), count_(0) {}
+
+      LogSiteSummary check()
+      {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (count % n_ != 0)
+        {
+          return LogSiteSummary{0};
+        }
+        return LogSiteSummary{count == 0 ? 1 : n_};
+      }
+
+    private:
+      const uint64_t n_;
+      std::atomic<uint64_t> count_;
+  };
+
+  ///
+  /// @brief State of one LOG_EVERY_MS statement: logs at most one occurrence per interval and
+  /// counts the ones in between.
+  ///
+  class RateLimitedLogSite
+  {
+    public:
+      explicit RateLimitedLogSite(uint32_t interval_ms) : interval_ms_(interval_ms), next_ms_(0), suppressed_(0) {}
+
+      LogSiteSummary check()
+      {
+        uint64_t now_ms = coarseNowMs();
+        uint64_t next_ms = next_ms_.load(std::memory_order_relaxed);
+
+        // of several threads that see the interval expire, the one that moves the deadline logs
+        if (now_ms < next_ms ||
+            !next_ms_.compare_exchange_strong(next_ms, now_ms + interval_ms_, std::memory_order_relaxed))
+        {
+          suppressed_.fetch_add(1, std::memory_order_relaxed);
+          return LogSiteSummary{0};
+        }
+        return LogSiteSummary{suppressed_.exchange(0, std::memory_order_relaxed) + 1};
+      }
+
+    private:
+      /// CLOCK_MONOTONIC_COARSE is read from the vDSO without a syscall, its tick resolution is plenty here
+      static uint64_t coarseNowMs()
+      {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+      }
+
+      const uint64_t interval_ms_;
+      std::atomic<uint64_t> next_ms_;
+      std::atomic<uint64_t> suppressed_;
+  };
+};
+
+///
+/// @brief Logs the 1st, n+1st, 2n+1st, ... time the statement is reached, e.g.
+/// LOG_EVERY_N(INFO, 100) << "TTM - Received " << name;
+/// Every line but the first is prefixed with "[xn] ". Each statement keeps its own count,
+/// shared by all threads that reach it.
+///
+#define LOG_EVERY_N(level, n) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (!g3::logLevel(level)) {} \
+  else if (logging::LogSiteSummary logging_summary = \
+             [&]() { static logging::EveryNLogSite logging_site(n); return logging_site.check(); }(); \
+           !logging_summary) {} \
+  else INTERNAL_LOG_MESSAGE(level).stream() << logging_summary
+
+///
+/// @brief Logs the statement at most once per interval_ms, e.g.
+/// LOG_EVERY_MS(WARNING, 1000) << "MUDP - dropping malformed record";
+/// A line that stands for more than one occurrence, the ones skipped since the previous line
+/// included, is prefixed with "[x<count>] ". A skipped occurrence costs an atomic increment and
+/// a coarse clock read, its stream arguments are not evaluated.
+///
+#define LOG_EVERY_MS(level, interval_ms) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (!g3::logLevel(level)) {} \
+  else if (logging::LogSiteSummary logging_summary = \
+             [&]() { static logging::RateLimitedLogSite logging_site(interval_ms); return logging_site.check(); }(); \
+           !logging_summary) {} \
+  else INTERNAL_LOG_MESSAGE(level).stream() << logging_summary
+
+///
+/// @brief BLOG at most once per interval_ms, e.g.
+/// BLOG_EVERY_MS(INFO, 1000, "MUDP - Received {} of {} bytes", stream_name, size);
+/// The record is prefixed with "[x<count>] ", the occurrences it stands for. A skipped
+/// occurrence costs what a skipped LOG_EVERY_MS does and writes nothing to the binary log.
+///
+#define BLOG_EVERY_MS(level, interval_ms, format, ...) \
+  if constexpr (!LOGGING_COMPILED_IN(level)) {} \
+  else if (logging::LogSiteSummary logging_summary = \
+             [&]() { static logging::RateLimitedLogSite logging_site(interval_ms); return logging_site.check(); }(); \
+           !logging_summary) {} \
+  else BLOG(level, "[x{}] " format, logging_summary.occurrences, ##__VA_ARGS__)
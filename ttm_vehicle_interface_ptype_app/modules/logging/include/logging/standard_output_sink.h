@@ -1,24 +1,89 @@
-
-
 #pragma once
 
 #include <g3log/logmessage.hpp>
 
-namespace logging 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+namespace logging
 {
   ///
-  /// @brief Standard output logging class that provides the sink callback function 
+  /// @brief How StandardOutputSink writes to the terminal.
+  ///
+  enum class StandardOutputMode
+  {
+    /// each line is written to std::cout from the sink callback
+    IMMEDIATE,
+    /// lines are collected in a bounded backlog that a flush thread writes with one write() per batch
+    BUFFERED
+  };
+
+  /// bytes of formatted lines a BUFFERED sink holds before it drops new ones
+  constexpr size_t default_output_backlog_bytes{1024 * 1024};
+  /// a BUFFERED sink writes pending lines at least this often
+  constexpr uint32_t default_output_flush_interval_ms{50};
+  /// pending bytes that make a BUFFERED sink write before the flush interval is up
+  constexpr size_t output_flush_threshold_bytes{16 * 1024};
+
+  ///
+  /// @brief Standard output logging class that provides the sink callback function
   /// for g3log
-  /// 
+  ///
   class StandardOutputSink
   {
     public:
       ///
-      /// @brief Callback function which can be registered to the g3log sink. 
-      /// 
-      /// @param mover populated by the g3log library with the content and context 
+      /// @param mode BUFFERED keeps a slow console from backing up the g3log queue
+      /// @param backlog_bytes BUFFERED only, lines that do not fit are dropped and counted
+      /// @param flush_interval_ms BUFFERED only, longest time a line waits to be written
+      ///
+      explicit StandardOutputSink(StandardOutputMode mode = StandardOutputMode::IMMEDIATE,
+                                  size_t backlog_bytes = default_output_backlog_bytes,
+                                  uint32_t flush_interval_ms = default_output_flush_interval_ms);
+      StandardOutputSink(const StandardOutputSink&) = delete;
+      StandardOutputSink& operator=(const StandardOutputSink&) = delete;
+
+      ///
+      /// @brief Writes what is still pending and stops the flush thread.
+      ///
+      ~StandardOutputSink();
+
+      ///
+      /// @brief Callback function which can be registered to the g3log sink.
+      ///
+      /// @param mover populated by the g3log library with the content and context
       /// of the log message.
       void logMessageCallback(g3::LogMessageMover mover);
+
+      ///
+      /// @brief Lines a BUFFERED sink dropped because the console could not keep up.
+      ///
+      uint64_t droppedLines() const;
+
+    private:
+      void flushPending();
+      static void writeAll(const std::string& data);
+
+      StandardOutputMode mode_;
+      size_t backlog_bytes_;
+      uint32_t flush_interval_ms_;
+
+      // reused by the callback for every line, only touched by the g3log sink thread
+      std::string line_;
+
+      std::mutex mutex_;
+      std::condition_variable flush_condition_;
+      // lines waiting for the flush thread; writing_ is the batch it currently writes
+      std::string pending_;
+      std::string writing_;
+      uint64_t unreported_drops_;
+      bool stopping_;
+      std::atomic<uint64_t> dropped_;
+      std::thread flush_thread_;
   };
 }
-
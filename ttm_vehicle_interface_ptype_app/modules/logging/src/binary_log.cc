@@ -0,0 +1,405 @@
+#include "logging/binary_log.h"
+
+#include <chrono>
+#include <time.h>
+
+using namespace logging;
+using namespace logging::binary_log;
+
+namespace logging {
+
+  ///
+  /// @brief Single producer, single consumer byte ring of one logging thread. Each record starts
+  /// with its u16 size; the writer thread is the only consumer.
+  ///
+  class BinaryLogRing
+  {
+    public:
+      explicit BinaryLogRing(uint32_t thread_index)
+        : data_(binary_log_ring_bytes),
+          head_(0),
+          tail_(0),
+          dropped_(0),
+          thread_index_(thread_index),
+          reported_drops_(0)
+      {
+      }
+
+      void push(const uint8_t* record, size_t size)
+      {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail + size > data_.size())
+        {
+          // only this thread writes dropped_, no read-modify-write needed
+          dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+          return;
+        }
+
+        copyIn(head, record, size);
+        head_.store(head + size, std::memory_order_release);
+      }
+
+      /// Moves the oldest record to out, which holds binary_log_max_record_size bytes.
+      /// @return size of the record, 0 if the ring is empty
+      size_t pop(uint8_t* out)
+      {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+          return 0;
+        }
+
+        uint16_t size;
+        copyOut(tail, reinterpret_cast<uint8_t*>(&size), sizeof(size));
+        copyOut(tail, out, size);
+        tail_.store(tail + size, std::memory_order_release);
+        return size;
+      }
+
+      uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+      uint32_t threadIndex() const { return thread_index_; }
+
+      /// Drops since the previous call, writer thread only.
+      uint64_t takeUnreportedDrops()
+      {
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        uint64_t unreported = dropped - reported_drops_;
+        reported_drops_ = dropped;
+        return unreported;
+      }
+
+    private:
+      void copyIn(uint64_t position, const uint8_t* source, size_t size)
+      {
+        size_t offset = position % data_.size();
+        size_t first = std::min(size, data_.size() - offset);
+        memcpy(data_.data() + offset, source, first);
+        memcpy(data_.data(), source + first, size - first);
+      }
+
+      void copyOut(uint64_t position, uint8_t* target, size_t size) const
+      {
+        size_t offset = position % data_.size();
+        size_t first = std::min(size, data_.size() - offset);
+        memcpy(target, data_.data() + offset, first);
+        memcpy(target + first, data_.data(), size - first);
+      }
+
+      std::vector<uint8_t> data_;
+      // producer and consumer positions on their own cache lines
+      alignas(64) std::atomic<uint64_t> head_;
+      alignas(64) std::atomic<uint64_t> tail_;
+      std::atomic<uint64_t> dropped_;
+      const uint32_t thread_index_;
+      uint64_t reported_drops_;
+  };
+};
+
+namespace {
+
+  // rings outlive their threads so records logged just before a thread exits are still written
+  thread_local BinaryLogRing* thread_ring = nullptr;
+
+  template <typename T>
+  void append(std::vector<uint8_t>& entry, T value)
+  {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    entry.insert(entry.end(), bytes, bytes + sizeof(value));
+  }
+
+  void appendText(std::vector<uint8_t>& entry, const char* text)
+  {
+    uint16_t size = (uint16_t)std::min(strlen(text), (size_t)UINT16_MAX);
+    append(entry, size);
+    entry.insert(entry.end(), text, text + size);
+  }
+
+  uint64_t realtimeNowNs()
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+  }
+}
+
+std::atomic<bool> BinaryLog::enabled_{false};
+
+BinaryLogSite::BinaryLogSite(const char* file, uint32_t line, uint8_t level, const char* format)
+  : file(file),
+    line(line),
+    level(level),
+    format(format),
+    id(BinaryLog::getInstance().registerSite(this))
+{
+}
+
+BinaryLog& BinaryLog::getInstance()
+{
+  static BinaryLog instance;
+  return instance;
+}
+
+BinaryLog::BinaryLog()
+  : max_file_bytes_(binary_log_default_max_file_bytes),
+    file_(nullptr),
+    file_bytes_(0),
+    file_records_(0),
+    sites_written_(0),
+    stopping_(false)
+{
+}
+
+BinaryLog::~BinaryLog()
+{
+  stop();
+  for (BinaryLogRing* ring : rings_)
+  {
+    delete ring;
+  }
+}
+
+bool BinaryLog::start(const std::string& file_path, size_t max_file_bytes)
+{
+  stop();
+
+  file_path_ = file_path;
+  max_file_bytes_ = max_file_bytes;
+  if (!openFile())
+  {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    // records and drops from an earlier run belong to the earlier file
+    uint8_t discard[binary_log_max_record_size];
+    for (BinaryLogRing* ring : rings_)
+    {
+      while (ring->pop(discard) > 0) {}
+      ring->takeUnreportedDrops();
+    }
+  }
+
+  writer_thread_ = std::thread(&BinaryLog::writeLoop, this);
+  enabled_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void BinaryLog::stop()
+{
+  if (!writer_thread_.joinable())
+  {
+    return;
+  }
+
+  enabled_.store(false, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  stop_condition_.notify_one();
+  writer_thread_.join();
+
+  if (file_ != nullptr)
+  {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool BinaryLog::openFile()
+{
+  file_ = fopen(file_path_.c_str(), "wb");
+  if (file_ == nullptr)
+  {
+    return false;
+  }
+
+  fwrite(file_magic, 1, sizeof(file_magic), file_);
+  file_bytes_ = sizeof(file_magic);
+  file_records_ = 0;
+  sites_written_ = 0;
+  return true;
+}
+
+void BinaryLog::rotateIfFull(size_t site_count)
+{
+  // a file without records is not rotated, its sites alone may exceed the limit
+  if (file_ != nullptr && file_bytes_ >= max_file_bytes_ && file_records_ > 0)
+  {
+    fclose(file_);
+    file_ = nullptr;
+
+    std::string previous_path = file_path_ + ".1";
+    rename(file_path_.c_str(), previous_path.c_str());
+  }
+
+  // without a file what is drained is lost, the next check tries again
+  if (file_ == nullptr)
+  {
+    openFile();
+  }
+
+  // a new file starts without sites and gets all of them again
+  writeSites(site_count);
+}
+
+uint64_t BinaryLog::droppedRecords() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t dropped = 0;
+  for (const BinaryLogRing* ring : rings_)
+  {
+    dropped += ring->dropped();
+  }
+  return dropped;
+}
+
+uint32_t BinaryLog::registerSite(const BinaryLogSite* site)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  sites_.push_back(site);
+  return (uint32_t)(sites_.size() - 1);
+}
+
+BinaryLogRing* BinaryLog::registerThread()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  rings_.push_back(new BinaryLogRing((uint32_t)rings_.size() + 1));
+  return rings_.back();
+}
+
+void BinaryLog::commit(const BinaryLogSite& site, uint8_t* record, size_t size)
+{
+  if (thread_ring == nullptr)
+  {
+    thread_ring = getInstance().registerThread();
+  }
+
+  uint16_t record_size = (uint16_t)size;
+  uint64_t time_ns = realtimeNowNs();
+  memcpy(record, &record_size, sizeof(record_size));
+  memcpy(record + sizeof(record_size), &site.id, sizeof(site.id));
+  memcpy(record + sizeof(record_size) + sizeof(site.id), &time_ns, sizeof(time_ns));
+
+  thread_ring->push(record, size);
+}
+
+void BinaryLog::writeLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true)
+  {
+    bool stopping = stop_condition_.wait_for(lock, std::chrono::milliseconds(binary_log_flush_interval_ms),
+                                             [this]() { return stopping_; });
+    lock.unlock();
+
+    // after stop() cleared enabled_ a final pass picks up what was logged before
+    while (drain()) {}
+    if (file_ != nullptr)
+    {
+      fflush(file_);
+    }
+
+    if (stopping)
+    {
+      return;
+    }
+    lock.lock();
+  }
+}
+
+bool BinaryLog::drain()
+{
+  std::vector<BinaryLogRing*> rings;
+  size_t site_count;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings = rings_;
+    site_count = sites_.size();
+  }
+
+  // sites registered before a record was pushed are in site_count, each record writes them ahead
+  // of itself; rotating only there keeps an idle writer from moving the last records to <path>.1
+
+  bool wrote = false;
+  uint8_t record[binary_log_max_record_size];
+  for (BinaryLogRing* ring : rings)
+  {
+    size_t size;
+    while ((size = ring->pop(record)) > 0)
+    {
+      uint32_t site;
+      uint64_t time_ns;
+      memcpy(&site, record + sizeof(uint16_t), sizeof(site));
+      memcpy(&time_ns, record + sizeof(uint16_t) + sizeof(site), sizeof(time_ns));
+
+      // a site first reached during this drain registered after site_count was read; its record
+      // was pushed after the registration, so re-reading the count covers it
+      if (site >= site_count)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        site_count = sites_.size();
+      }
+      rotateIfFull(site_count);
+
+      entry_.clear();
+      append(entry_, EntryType::RECORD);
+      append(entry_, site);
+      append(entry_, ring->threadIndex());
+      append(entry_, time_ns);
+      append(entry_, (uint16_t)(size - record_header_size));
+      entry_.insert(entry_.end(), record + record_header_size, record + size);
+      writeEntry();
+      ++file_records_;
+      wrote = true;
+    }
+
+    uint64_t dropped = ring->takeUnreportedDrops();
+    if (dropped > 0)
+    {
+      entry_.clear();
+      append(entry_, EntryType::DROPS);
+      append(entry_, ring->threadIndex());
+      append(entry_, dropped);
+      writeEntry();
+    }
+  }
+
+  return wrote;
+}
+
+void BinaryLog::writeSites(size_t count)
+{
+  while (sites_written_ < count)
+  {
+    const BinaryLogSite* site;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      site = sites_[sites_written_];
+    }
+
+    entry_.clear();
+    // the index is the site id, which the constructor may still be storing
+    append(entry_, EntryType::SITE);
+    append(entry_, (uint32_t)sites_written_);
+    append(entry_, site->level);
+    append(entry_, site->line);
+    appendText(entry_, site->file);
+    appendText(entry_, site->format);
+    writeEntry();
+    ++sites_written_;
+  }
+}
+
+void BinaryLog::writeEntry()
+{
+  if (file_ != nullptr)
+  {
+    fwrite(entry_.data(), 1, entry_.size(), file_);
+    file_bytes_ += entry_.size();
+  }
+}
@@ -6,8 +6,11 @@
 
 using namespace logging;
 
-void Logger::initialize()
+StandardOutputMode Logger::standard_output_mode_ = StandardOutputMode::IMMEDIATE;
+
+void Logger::initialize(StandardOutputMode standard_output_mode)
 {
+  standard_output_mode_ = standard_output_mode;
   getInstance();
 }
 
@@ -17,7 +20,7 @@ Logger::Logger()
 
   if(standard_output_enabled_)
   {
-    standard_out_sink_handle_ = log_worker_->addSink(std::make_unique<StandardOutputSink>(), 
+    standard_out_sink_handle_ = log_worker_->addSink(std::make_unique<StandardOutputSink>(standard_output_mode_), 
       &StandardOutputSink::logMessageCallback);  
   }
 
@@ -37,6 +40,16 @@ void Logger::enableFileOutput(std::string prefix, std::string file_path)
   file_sink_handle_ = log_worker_->addDefaultLogger(prefix, file_path);
 }
 
+uint64_t Logger::droppedStandardOutputLines()
+{
+  if (!standard_out_sink_handle_)
+  {
+    return 0;
+  }
+
+  return standard_out_sink_handle_->call(&StandardOutputSink::droppedLines).get();
+}
+
 Logger& Logger::getInstance()
 {
   static Logger logger_singleton;
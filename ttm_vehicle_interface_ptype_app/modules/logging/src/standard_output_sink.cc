@@ -4,7 +4,10 @@
 #include "logging/standard_output_sink.h"
 #include "logging/additional_logging_levels.h"
 
+#include <chrono>
+#include <errno.h>
 #include <iostream>
+#include <unistd.h>
 
 using namespace logging;
 
@@ -39,12 +42,147 @@ const char* getColorSeq(const LEVELS& level) {
   return RESET_SEQ;
 }
 
+StandardOutputSink::StandardOutputSink(StandardOutputMode mode, size_t backlog_bytes, uint32_t flush_interval_ms)
+  : mode_(mode),
+    backlog_bytes_(backlog_bytes),
+    flush_interval_ms_(flush_interval_ms),
+    unreported_drops_(0),
+    stopping_(false),
+    dropped_(0)
+{
+  if (mode_ == StandardOutputMode::BUFFERED)
+  {
+    pending_.reserve(output_flush_threshold_bytes);
+    writing_.reserve(output_flush_threshold_bytes);
+    flush_thread_ = std::thread(&StandardOutputSink::flushPending, this);
+  }
+}
+
+StandardOutputSink::~StandardOutputSink()
+{
+  if (flush_thread_.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    flush_condition_.notify_one();
+    flush_thread_.join();
+  }
+}
+
 void StandardOutputSink::logMessageCallback(g3::LogMessageMover mover)
 {
-  g3::LogMessage msg = mover.get();
+  const g3::LogMessage& msg = mover.get();
+
+  if (mode_ == StandardOutputMode::IMMEDIATE)
+  {
+    std::cout << BOLD_BLACK_SEQ << "[" << msg.file() << ":"
+      << msg.line() << "] " << getColorSeq(msg._level)
+      << msg.level() << ": " << msg.message() << "\n" << RESET_SEQ;
+    return;
+  }
+
+  // same format as IMMEDIATE, appended to a buffer that keeps its capacity between lines
+  line_.clear();
+  line_ += BOLD_BLACK_SEQ;
+  line_ += "[";
+  line_ += msg.file();
+  line_ += ":";
+  line_ += msg.line();
+  line_ += "] ";
+  line_ += getColorSeq(msg._level);
+  line_ += msg.level();
+  line_ += ": ";
+  line_ += msg.message();
+  line_ += "\n";
+  line_ += RESET_SEQ;
+
+  if (g3::internal::wasFatal(msg._level))
+  {
+    // g3log aborts once this callback returns, the flush thread would never write the reason
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ += line_;
+    writeAll(pending_);
+    pending_.clear();
+    return;
+  }
+
+  bool flush_now = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() + line_.size() > backlog_bytes_)
+    {
+      ++unreported_drops_;
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    pending_ += line_;
+    flush_now = pending_.size() >= output_flush_threshold_bytes;
+  }
+
+  if (flush_now)
+  {
+    flush_condition_.notify_one();
+  }
+}
+
+void StandardOutputSink::flushPending()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true)
+  {
+    flush_condition_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_), [this]() {
+      return stopping_ || pending_.size() >= output_flush_threshold_bytes;
+    });
+
+    if (pending_.empty() && unreported_drops_ == 0)
+    {
+      if (stopping_)
+      {
+        return;
+      }
+      continue;
+    }
 
-  std::cout << BOLD_BLACK_SEQ << "[" << msg.file() << ":" 
-    << msg.line() << "] " << getColorSeq(msg._level) 
-    << msg.level() << ": " << msg.message() << "\n" << RESET_SEQ;
+    // the callback keeps appending to the other buffer while this batch is written
+    writing_.swap(pending_);
+    uint64_t drops = unreported_drops_;
+    unreported_drops_ = 0;
+    lock.unlock();
+
+    if (drops > 0)
+    {
+      writing_ += "[" + std::to_string(drops) + " log lines dropped, standard output could not keep up]\n";
+    }
+    writeAll(writing_);
+    writing_.clear();
+
+    lock.lock();
+  }
+}
+
+void StandardOutputSink::writeAll(const std::string& data)
+{
+  size_t written = 0;
+  while (written < data.size())
+  {
+    ssize_t n = ::write(STDOUT_FILENO, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return;
+    }
+    written += (size_t)n;
+  }
 }
 
+uint64_t StandardOutputSink::droppedLines() const
+{
+  return dropped_.load(std::memory_order_relaxed);
+}
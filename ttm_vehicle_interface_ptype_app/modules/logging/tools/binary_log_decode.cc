@@ -0,0 +1,239 @@
+///
+/// Turns a file written by logging::BinaryLog into text, one line per record:
+///
+///   2026-01-01 12:00:00.000000123 INFO [ttm_data_udp.cc:120] T2: MUDP - Received VehicleState
+///
+/// usage: binary_log_decode <file>
+///
+
+#include "logging/binary_log_format.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace logging::binary_log;
+
+namespace {
+
+  struct Site
+  {
+    uint8_t level;
+    uint32_t line;
+    std::string file;
+    std::string format;
+  };
+
+  class Reader
+  {
+    public:
+      explicit Reader(std::istream& input) : input_(input) {}
+
+      template <typename T>
+      bool read(T& value)
+      {
+        return (bool)input_.read(reinterpret_cast<char*>(&value), sizeof(value));
+      }
+
+      bool readText(std::string& text)
+      {
+        uint16_t size;
+        if (!read(size))
+        {
+          return false;
+        }
+        text.resize(size);
+        return (bool)input_.read(&text[0], size);
+      }
+
+    private:
+      std::istream& input_;
+  };
+
+  const char* levelName(uint8_t level)
+  {
+    static const char* names[] = {"DEBUG", "INFO", "WARNING", "ERROR", "FATAL"};
+    return level < sizeof(names) / sizeof(names[0]) ? names[level] : "UNKNOWN";
+  }
+
+  std::string formatTime(uint64_t time_ns)
+  {
+    time_t seconds = (time_t)(time_ns / 1000000000ull);
+    struct tm local;
+    localtime_r(&seconds, &local);
+
+    char text[64];
+    size_t size = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(text + size, sizeof(text) - size, ".%09llu", (unsigned long long)(time_ns % 1000000000ull));
+    return text;
+  }
+
+  /// Renders the arguments of a record; malformed ones end the list.
+  std::vector<std::string> decodeArgs(const std::string& args)
+  {
+    std::vector<std::string> values;
+    size_t position = 0;
+
+    auto take = [&](void* value, size_t size) {
+      if (position + size > args.size())
+      {
+        return false;
+      }
+      memcpy(value, args.data() + position, size);
+      position += size;
+      return true;
+    };
+
+    uint8_t type;
+    while (take(&type, sizeof(type)))
+    {
+      std::ostringstream value;
+      switch ((ArgType)type)
+      {
+        case ArgType::INT32: { int32_t v; if (!take(&v, sizeof(v))) return values; value << v; break; }
+        case ArgType::UINT32: { uint32_t v; if (!take(&v, sizeof(v))) return values; value << v; break; }
+        case ArgType::INT64: { int64_t v; if (!take(&v, sizeof(v))) return values; value << v; break; }
+        case ArgType::UINT64: { uint64_t v; if (!take(&v, sizeof(v))) return values; value << v; break; }
+        case ArgType::DOUBLE: { double v; if (!take(&v, sizeof(v))) return values; value << v; break; }
+        case ArgType::STRING:
+        {
+          uint16_t size;
+          if (!take(&size, sizeof(size)) || position + size > args.size())
+          {
+            return values;
+          }
+          value.write(args.data() + position, size);
+          position += size;
+          break;
+        }
+        default:
+          return values;
+      }
+      values.push_back(value.str());
+    }
+    return values;
+  }
+
+  /// Replaces each {} of the format with the next argument, arguments left over are appended.
+  std::string formatMessage(const std::string& format, const std::vector<std::string>& args)
+  {
+    std::string message;
+    size_t next_arg = 0;
+    for (size_t i = 0; i < format.size(); ++i)
+    {
+      if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}' && next_arg < args.size())
+      {
+        message += args[next_arg++];
+        ++i;
+        continue;
+      }
+      message += format[i];
+    }
+    for (; next_arg < args.size(); ++next_arg)
+    {
+      message += " " + args[next_arg];
+    }
+    return message;
+  }
+
+  std::string baseName(const std::string& path)
+  {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <binary log file>\n";
+    return 2;
+  }
+
+  std::ifstream input(argv[1], std::ios::binary);
+  if (!input)
+  {
+    std::cerr << "cannot open " << argv[1] << "\n";
+    return 1;
+  }
+
+  char magic[sizeof(file_magic)];
+  if (!input.read(magic, sizeof(magic)) || memcmp(magic, file_magic, sizeof(magic)) != 0)
+  {
+    std::cerr << argv[1] << " is not a binary log\n";
+    return 1;
+  }
+
+  Reader reader(input);
+  std::unordered_map<uint32_t, Site> sites;
+  uint8_t type;
+
+  while (reader.read(type))
+  {
+    switch ((EntryType)type)
+    {
+      case EntryType::SITE:
+      {
+        uint32_t id;
+        Site site;
+        if (!reader.read(id) || !reader.read(site.level) || !reader.read(site.line) ||
+            !reader.readText(site.file) || !reader.readText(site.format))
+        {
+          std::cerr << "truncated site entry\n";
+          return 1;
+        }
+        sites[id] = std::move(site);
+        break;
+      }
+
+      case EntryType::RECORD:
+      {
+        uint32_t site_id;
+        uint32_t thread;
+        uint64_t time_ns;
+        std::string args;
+        if (!reader.read(site_id) || !reader.read(thread) || !reader.read(time_ns) || !reader.readText(args))
+        {
+          std::cerr << "truncated record entry\n";
+          return 1;
+        }
+
+        auto site = sites.find(site_id);
+        if (site == sites.end())
+        {
+          std::cout << formatTime(time_ns) << " UNKNOWN [site " << site_id << "] T" << thread << "\n";
+          break;
+        }
+        std::cout << formatTime(time_ns) << " " << levelName(site->second.level) << " ["
+                  << baseName(site->second.file) << ":" << site->second.line << "] T" << thread << ": "
+                  << formatMessage(site->second.format, decodeArgs(args)) << "\n";
+        break;
+      }
+
+      case EntryType::DROPS:
+      {
+        uint32_t thread;
+        uint64_t count;
+        if (!reader.read(thread) || !reader.read(count))
+        {
+          std::cerr << "truncated drops entry\n";
+          return 1;
+        }
+        std::cout << "[" << count << " records of T" << thread << " dropped, its ring was full]\n";
+        break;
+      }
+
+      default:
+        std::cerr << "unknown entry type " << (int)type << "\n";
+        return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics
+{
+  /// Bridge direction a counter belongs to, named after where the traffic comes from and goes to.
+  enum class Direction : uint8_t
+  {
+    MABX_TO_TTM = 0,
+    TTM_TO_MABX = 1
+  };
+  constexpr size_t direction_count{2};
+
+  enum class Counter : uint8_t
+  {
+    /// datagrams or messages received, malformed ones included
+    RX_PACKETS = 0,
+    RX_BYTES = 1,
+    /// datagrams or messages handed to the socket
+    TX_PACKETS = 2,
+    TX_BYTES = 3,
+    /// records lost to a full queue, an exhausted pool, a missing peer, an unbridged stream or an incomplete chunk series
+    DROPS = 4,
+    /// records of latest value streams replaced by a newer one before they were sent
+    COALESCED = 5,
+    /// malformed datagrams and JSON messages, unknown msg_type included
+    PARSE_ERRORS = 6,
+    /// messages the kernel refused to send
+    SEND_ERRORS = 7,
+    /// records that exceeded the maximum age of their stream before they were sent
+    EXPIRED = 8,
+    /// datagrams the kernel dropped because the socket receive buffer was full, see SO_RXQ_OVFL
+    KERNEL_DROPS = 9
+  };
+  constexpr size_t counter_count{10};
+
+  /// one slot per UDPRecord_Header::streamNumber plus unknown_stream
+  constexpr size_t counter_stream_count{257};
+  /// stream slot of packets whose stream is not known, e.g. a JSON message that does not parse
+  constexpr uint16_t unknown_stream{256};
+
+  ///
+  /// @brief Packet, byte and error counters per direction and stream.
+  ///
+  /// Every thread that counts gets its own block of counters, registered on its first add().
+  /// Only that thread writes the block, so add() is a plain load and store with no lock and no
+  /// atomic read-modify-write. Readers sum the blocks of all threads; blocks of exited threads
+  /// are kept so that their counts do not go missing.
+  ///
+  class Counters
+  {
+    public:
+      static Counters& getInstance();
+
+      ///
+      /// @brief Adds to a counter of the calling thread.
+      ///
+      /// @param stream UDPRecord_Header::streamNumber or unknown_stream
+      ///
+      static void add(Direction direction, uint16_t stream, Counter counter, uint64_t value = 1);
+
+      /// Sum of one counter over all threads.
+      uint64_t read(Direction direction, uint16_t stream, Counter counter) const;
+
+      ///
+      /// @brief All non-zero counters as text, one line per counter, e.g.
+      /// bridge_rx_packets{direction="mabx_to_ttm",stream="5"} 120
+      ///
+      std::string format() const;
+
+      Counters(const Counters&) = delete;
+      Counters& operator=(const Counters&) = delete;
+
+    private:
+      static constexpr size_t block_size{direction_count * counter_stream_count * counter_count};
+
+      struct alignas(64) Block
+      {
+        std::array<std::atomic<uint64_t>, block_size> values;
+      };
+
+      Counters() = default;
+      Block* registerThread();
+      static size_t index(Direction direction, uint16_t stream, Counter counter);
+      void sum(std::vector<uint64_t>& totals) const;
+
+      // guards blocks_, taken once per thread on registration and by readers
+      mutable std::mutex mutex_;
+      std::vector<std::unique_ptr<Block>> blocks_;
+  };
+
+  ///
+  /// @brief Serves Counters::format() on a Unix stream socket: every connection gets one
+  /// snapshot and is closed, e.g. `socat - UNIX-CONNECT:<path>`.
+  ///
+  class CounterServer
+  {
+    public:
+      CounterServer();
+      CounterServer(const CounterServer&) = delete;
+      CounterServer& operator=(const CounterServer&) = delete;
+      ~CounterServer();
+
+      ///
+      /// @brief Binds the socket, replacing a stale one at path, and starts the server thread.
+      ///
+      /// @return false if the socket could not be set up
+      ///
+      bool start(const std::string& path);
+      void stop();
+
+    private:
+      void serve();
+
+      int socket_fd_;
+      std::string path_;
+      std::atomic<bool> running_;
+      std::thread thread_;
+  };
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace metrics
+{
+  /// significant bits kept of a recorded value, i.e. 2^5 sub buckets per power of two (<= 3.2% error)
+  constexpr unsigned latency_sub_bucket_bits{5};
+  /// values from 2^36 ns (about 68 s) up are counted in the last bucket
+  constexpr unsigned latency_max_value_bits{36};
+  constexpr size_t latency_sub_bucket_count{(size_t)1 << latency_sub_bucket_bits};
+  constexpr size_t latency_bucket_count{(latency_max_value_bits - latency_sub_bucket_bits + 1) * latency_sub_bucket_count};
+
+  ///
+  /// @brief Log-linear (HDR style) histogram of latencies in ns.
+  ///
+  /// Values below 2^latency_sub_bucket_bits are counted exactly, above that every power of two
+  /// is split into latency_sub_bucket_count buckets. Recording is wait-free and may happen from
+  /// any thread; snapshot() reads the counters without stopping writers, so a snapshot taken
+  /// while records come in can be off by the records in flight.
+  ///
+  class LatencyHistogram
+  {
+    public:
+      LatencyHistogram();
+      LatencyHistogram(const LatencyHistogram&) = delete;
+      LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+      void record(uint64_t value_ns);
+
+      /// Copy of the counters at one point in time.
+      struct Snapshot
+      {
+        uint64_t count;
+        uint64_t min_ns;
+        uint64_t max_ns;
+        /// sum of all values, divide by count for the mean
+        uint64_t total_ns;
+        std::vector<uint64_t> buckets;
+
+        ///
+        /// @brief Highest value equivalent to the bucket holding the given percentile.
+        ///
+        /// @param percentile in [0, 100]
+        /// @return 0 if nothing was recorded
+        ///
+        uint64_t valueAtPercentile(double percentile) const;
+      };
+      Snapshot snapshot() const;
+
+      static size_t bucketIndex(uint64_t value_ns);
+      /// Highest value counted in the bucket.
+      static uint64_t bucketUpperBound(size_t index);
+
+    private:
+      std::array<std::atomic<uint64_t>, latency_bucket_count> buckets_;
+      std::atomic<uint64_t> count_;
+      std::atomic<uint64_t> min_ns_;
+      std::atomic<uint64_t> max_ns_;
+      std::atomic<uint64_t> total_ns_;
+  };
+
+  /// one histogram slot per value of UDPRecord_Header::streamNumber
+  constexpr size_t latency_stream_count{256};
+
+  ///
+  /// @brief One LatencyHistogram per stream number, allocated when a stream records its first value.
+  ///
+  class StreamLatencyHistograms
+  {
+    public:
+      StreamLatencyHistograms();
+      StreamLatencyHistograms(const StreamLatencyHistograms&) = delete;
+      StreamLatencyHistograms& operator=(const StreamLatencyHistograms&) = delete;
+      ~StreamLatencyHistograms();
+
+      void record(uint8_t stream_number, uint64_t value_ns);
+
+      /// Histogram of a stream, nullptr until the stream recorded a value.
+      const LatencyHistogram* stream(uint8_t stream_number) const;
+
+    private:
+      std::array<std::atomic<LatencyHistogram*>, latency_stream_count> streams_;
+  };
+}
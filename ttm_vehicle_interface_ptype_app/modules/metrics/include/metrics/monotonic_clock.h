@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <time.h>
+
+namespace metrics
+{
+  ///
+  /// @brief Monotonic time in ns, the clock all latencies of the bridge are measured with.
+  ///
+  inline uint64_t monotonicNowNs()
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>
+             (std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  ///
+  /// @brief CLOCK_REALTIME in ns, the clock kernel receive timestamps are taken with.
+  ///
+  inline uint64_t realtimeNowNs()
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  }
+}
@@ -0,0 +1,208 @@
+#include "metrics/counters.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace metrics
+{
+  namespace
+  {
+    constexpr const char* direction_names[direction_count] = {"mabx_to_ttm", "ttm_to_mabx"};
+    constexpr const char* counter_names[counter_count] = {
+      "bridge_rx_packets", "bridge_rx_bytes", "bridge_tx_packets", "bridge_tx_bytes",
+      "bridge_drops", "bridge_coalesced", "bridge_parse_errors", "bridge_send_errors",
+      "bridge_expired", "bridge_kernel_drops"};
+    /// how often the server thread checks whether stop() was called
+    constexpr int counter_server_poll_ms{200};
+  }
+
+  Counters& Counters::getInstance()
+  {
+    static Counters instance;
+    return instance;
+  }
+
+  size_t Counters::index(Direction direction, uint16_t stream, Counter counter)
+  {
+    if (stream >= counter_stream_count)
+    {
+      stream = unknown_stream;
+    }
+    return ((size_t)direction * counter_stream_count + stream) * counter_count + (size_t)counter;
+  }
+
+  void Counters::add(Direction direction, uint16_t stream, Counter counter, uint64_t value)
+  {
+    thread_local Block* block = getInstance().registerThread();
+
+    // this thread is the only writer of its block, readers only need the store to be atomic
+    std::atomic<uint64_t>& target = block->values[index(direction, stream, counter)];
+    target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  Counters::Block* Counters::registerThread()
+  {
+    std::unique_ptr<Block> block(new Block());
+    for (std::atomic<uint64_t>& value : block->values)
+    {
+      value.store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_.push_back(std::move(block));
+    return blocks_.back().get();
+  }
+
+  uint64_t Counters::read(Direction direction, uint16_t stream, Counter counter) const
+  {
+    size_t i = index(direction, stream, counter);
+    uint64_t total = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<Block>& block : blocks_)
+    {
+      total += block->values[i].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  void Counters::sum(std::vector<uint64_t>& totals) const
+  {
+    totals.assign(block_size, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<Block>& block : blocks_)
+    {
+      for (size_t i = 0; i < block_size; ++i)
+      {
+        totals[i] += block->values[i].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::string Counters::format() const
+  {
+    std::vector<uint64_t> totals;
+    sum(totals);
+
+    std::string text;
+    for (size_t direction = 0; direction < direction_count; ++direction)
+    {
+      for (size_t stream = 0; stream < counter_stream_count; ++stream)
+      {
+        for (size_t counter = 0; counter < counter_count; ++counter)
+        {
+          uint64_t value = totals[(direction * counter_stream_count + stream) * counter_count + counter];
+          if (value == 0)
+          {
+            continue;
+          }
+
+          text += counter_names[counter];
+          text += "{direction=\"";
+          text += direction_names[direction];
+          text += "\",stream=\"";
+          text += stream == unknown_stream ? std::string("unknown") : std::to_string(stream);
+          text += "\"} ";
+          text += std::to_string(value);
+          text += '\n';
+        }
+      }
+    }
+    return text;
+  }
+
+  CounterServer::CounterServer() : socket_fd_(-1),
+                                   running_(false)
+  {
+  }
+
+  bool CounterServer::start(const std::string& path)
+  {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+      return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    socket_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd_ < 0)
+    {
+      return false;
+    }
+
+    unlink(path.c_str());
+    if (bind(socket_fd_, (const struct sockaddr*)&address, sizeof(address)) < 0 || listen(socket_fd_, 4) < 0)
+    {
+      close(socket_fd_);
+      socket_fd_ = -1;
+      return false;
+    }
+
+    path_ = path;
+    running_.store(true);
+    thread_ = std::thread(&CounterServer::serve, this);
+    return true;
+  }
+
+  void CounterServer::serve()
+  {
+    struct pollfd listen_fd = {socket_fd_, POLLIN, 0};
+
+    while (running_.load())
+    {
+      if (poll(&listen_fd, 1, counter_server_poll_ms) <= 0)
+      {
+        continue;
+      }
+
+      int client_fd = accept4(socket_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client_fd < 0)
+      {
+        continue;
+      }
+
+      std::string text = Counters::getInstance().format();
+      size_t written = 0;
+      while (written < text.size())
+      {
+        ssize_t n = send(client_fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        if (n <= 0)
+        {
+          break;
+        }
+        written += (size_t)n;
+      }
+      close(client_fd);
+    }
+  }
+
+  void CounterServer::stop()
+  {
+    if (!running_.exchange(false))
+    {
+      return;
+    }
+
+    thread_.join();
+    close(socket_fd_);
+    socket_fd_ = -1;
+    unlink(path_.c_str());
+  }
+
+  CounterServer::~CounterServer()
+  {
+    stop();
+  }
+}
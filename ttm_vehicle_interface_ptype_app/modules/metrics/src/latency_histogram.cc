@@ -0,0 +1,166 @@
+#include "metrics/latency_histogram.h"
+
+#include <limits>
+
+namespace metrics
+{
+  namespace
+  {
+    constexpr uint64_t latency_max_value{((uint64_t)1 << latency_max_value_bits) - 1};
+
+    void storeMin(std::atomic<uint64_t>& target, uint64_t value)
+    {
+      uint64_t current = target.load(std::memory_order_relaxed);
+      while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    void storeMax(std::atomic<uint64_t>& target, uint64_t value)
+    {
+      uint64_t current = target.load(std::memory_order_relaxed);
+      while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+  }
+
+  LatencyHistogram::LatencyHistogram() : count_(0),
+                                         min_ns_(std::numeric_limits<uint64_t>::max()),
+                                         max_ns_(0),
+                                         total_ns_(0)
+  {
+    for (std::atomic<uint64_t>& bucket : buckets_)
+    {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  size_t LatencyHistogram::bucketIndex(uint64_t value_ns)
+  {
+    if (value_ns > latency_max_value)
+    {
+      value_ns = latency_max_value;
+    }
+    if (value_ns < latency_sub_bucket_count)
+    {
+      return (size_t)value_ns;
+    }
+
+    // exponent of the highest set bit, the next latency_sub_bucket_bits bits pick the sub bucket
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value_ns);
+    unsigned shift = exponent - latency_sub_bucket_bits;
+    size_t mantissa = (size_t)(value_ns >> shift);
+    return (shift + 1) * latency_sub_bucket_count + (mantissa - latency_sub_bucket_count);
+  }
+
+  uint64_t LatencyHistogram::bucketUpperBound(size_t index)
+  {
+    if (index < latency_sub_bucket_count)
+    {
+      return index;
+    }
+
+    size_t shift = index / latency_sub_bucket_count - 1;
+    uint64_t mantissa = latency_sub_bucket_count + index % latency_sub_bucket_count;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  void LatencyHistogram::record(uint64_t value_ns)
+  {
+    buckets_[bucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(value_ns, std::memory_order_relaxed);
+    storeMin(min_ns_, value_ns);
+    storeMax(max_ns_, value_ns);
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+  {
+    Snapshot snapshot;
+    snapshot.buckets.resize(latency_bucket_count);
+    snapshot.count = 0;
+    for (size_t i = 0; i < latency_bucket_count; ++i)
+    {
+      snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+      // counted from the buckets so that count and percentiles agree
+      snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.total_ns = total_ns_.load(std::memory_order_relaxed);
+    snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+    snapshot.min_ns = snapshot.count ? min_ns_.load(std::memory_order_relaxed) : 0;
+    return snapshot;
+  }
+
+  uint64_t LatencyHistogram::Snapshot::valueAtPercentile(double percentile) const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    if (percentile < 0.0)
+    {
+      percentile = 0.0;
+    }
+    if (percentile > 100.0)
+    {
+      percentile = 100.0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+    if (rank == 0)
+    {
+      rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+      seen += buckets[i];
+      if (seen >= rank)
+      {
+        uint64_t bound = bucketUpperBound(i);
+        return bound < max_ns ? bound : max_ns;
+      }
+    }
+    return max_ns;
+  }
+
+  StreamLatencyHistograms::StreamLatencyHistograms()
+  {
+    for (std::atomic<LatencyHistogram*>& stream : streams_)
+    {
+      stream.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  StreamLatencyHistograms::~StreamLatencyHistograms()
+  {
+    for (std::atomic<LatencyHistogram*>& stream : streams_)
+    {
+      delete stream.load(std::memory_order_relaxed);
+    }
+  }
+
+  void StreamLatencyHistograms::record(uint8_t stream_number, uint64_t value_ns)
+  {
+    std::atomic<LatencyHistogram*>& slot = streams_[stream_number];
+    LatencyHistogram* histogram = slot.load(std::memory_order_acquire);
+    if (!histogram)
+    {
+      // first value of the stream; if another thread got there first use its histogram
+      LatencyHistogram* created = new LatencyHistogram();
+      if (slot.compare_exchange_strong(histogram, created, std::memory_order_acq_rel))
+      {
+        histogram = created;
+      }
+      else
+      {
+        delete created;
+      }
+    }
+    histogram->record(value_ns);
+  }
+
+  const LatencyHistogram* StreamLatencyHistograms::stream(uint8_t stream_number) const
+  {
+    return streams_[stream_number].load(std::memory_order_acquire);
+  }
+}
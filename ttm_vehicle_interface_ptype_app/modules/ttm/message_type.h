@@ -1,3 +1,5 @@
+#pragma once
+
 enum message_type {
   vehicle_connect_request,
   ttm_reply,
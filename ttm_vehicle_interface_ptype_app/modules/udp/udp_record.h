@@ -46,5 +46,12 @@ struct UDPRecordBuffer_t
 static const int UDP_RECORD_VERSION = 0xA1;
 static const uint16_t UDP_RECORD_VERSIONINFO = ((UDP_RECORD_VERSION << 8) | sizeof(UDPRecord_Header));
 
+/// Largest record datagram that crosses a 1500 byte MTU link without IP fragmentation (minus IPv4 and UDP headers).
+static const uint16_t UDP_RECORD_MAX_DATAGRAM = 1500 - 20 - 8;
+/// Payload bytes of every chunk of a chunked record but the last, chunk i starts at i * UDP_RECORD_CHUNK_SIZE.
+static const uint16_t UDP_RECORD_CHUNK_SIZE = UDP_RECORD_MAX_DATAGRAM - sizeof(UDPRecord_Header);
+/// Chunks needed for the largest record.
+static const uint16_t UDP_RECORD_MAX_CHUNKS = (RACAM_UDP_RECORD_SIZE + UDP_RECORD_CHUNK_SIZE - 1) / UDP_RECORD_CHUNK_SIZE;
+
 #pragma pack(pop)
 
@@ -1,7 +1,25 @@
 #include "base.h"
 #include "logging/log.h"
+#include "logging/rate_limited_log.h"
+#include "metrics/monotonic_clock.h"
 
-Base::Base() {
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/net_tstamp.h>
+#include <linux/sock_diag.h>
+
+#include <algorithm>
+
+Base::Base() : socket_fd_(-1),
+               socket_backend_(SocketBackend::SYSCALL),
+               rx_timestamping_(RxTimestamping::NONE),
+               socket_tuning_(default_socket_tuning),
+               rx_thread_tuning_(default_thread_tuning),
+               tx_thread_tuning_(default_thread_tuning),
+               rx_stop_requested_(false),
+               tx_stop_deadline_ns_(0),
+               rx_overflow_total_(0),
+               rx_kernel_drops_(0) {
 
 }
 
@@ -11,7 +29,7 @@ bool Base::init(int rx_port, const char* tx_address, int tx_port) {
     int opt_val = 1;
     int error_number = 0;
 
-    socket_fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_UDP);
+    socket_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (socket_fd_ >= 0) {
         LOG(INFO) << "Created UDP socket, fd: " << socket_fd_;
     }
@@ -25,6 +43,13 @@ bool Base::init(int rx_port, const char* tx_address, int tx_port) {
             return false;
     }
     setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+    applySocketTuning();
+
+    if (rx_timestamping_ != RxTimestamping::NONE && !enableRxTimestamping())
+    {
+        LOG(WARNING) << "Kernel rx timestamps unavailable, stamping in user space: " << strerror(errno);
+        rx_timestamping_ = RxTimestamping::NONE;
+    }
 
     memset(&rx_address_, 0, sizeof(rx_address_));
 
@@ -45,9 +70,345 @@ bool Base::init(int rx_port, const char* tx_address, int tx_port) {
     return true;
 }
 
+namespace {
+
+void setBufferSize(int socket_fd, int force_option, int option, int bytes, const char* name) {
+
+    if (bytes <= 0) {
+        return;
+    }
+
+    if (setsockopt(socket_fd, SOL_SOCKET, force_option, &bytes, sizeof(bytes)) != 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, option, &bytes, sizeof(bytes)) != 0)
+    {
+        LOG(WARNING) << "Socket " << name << " buffer of " << bytes << " bytes refused: " << strerror(errno);
+        return;
+    }
+
+    // the kernel doubles a request for its bookkeeping, and caps one without FORCE at the sysctl maximum
+    int effective = 0;
+    socklen_t length = sizeof(effective);
+    getsockopt(socket_fd, SOL_SOCKET, option, &effective, &length);
+    if (effective / 2 < bytes) {
+        LOG(WARNING) << "Socket " << name << " buffer capped at " << effective / 2 << " of " << bytes
+                     << " bytes, raise net.core." << (option == SO_RCVBUF ? "rmem_max" : "wmem_max");
+    }
+}
+
+}
+
+void Base::applySocketTuning() {
+
+    setBufferSize(socket_fd_, SO_RCVBUFFORCE, SO_RCVBUF, socket_tuning_.receive_buffer_bytes, "receive");
+    setBufferSize(socket_fd_, SO_SNDBUFFORCE, SO_SNDBUF, socket_tuning_.send_buffer_bytes, "send");
+
+    if (socket_tuning_.busy_poll_us > 0 &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_BUSY_POLL, &socket_tuning_.busy_poll_us, sizeof(int)) != 0)
+    {
+        LOG(WARNING) << "SO_BUSY_POLL of " << socket_tuning_.busy_poll_us << " us refused: " << strerror(errno);
+    }
+
+    if (socket_tuning_.priority >= 0 &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_PRIORITY, &socket_tuning_.priority, sizeof(int)) != 0)
+    {
+        LOG(WARNING) << "SO_PRIORITY " << socket_tuning_.priority << " refused: " << strerror(errno);
+    }
+
+    if (socket_tuning_.tos >= 0 &&
+        setsockopt(socket_fd_, IPPROTO_IP, IP_TOS, &socket_tuning_.tos, sizeof(int)) != 0)
+    {
+        LOG(WARNING) << "IP_TOS " << socket_tuning_.tos << " refused: " << strerror(errno);
+    }
+
+    int enable = 1;
+    if (socket_tuning_.report_rx_overflow &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) != 0)
+    {
+        LOG(WARNING) << "SO_RXQ_OVFL refused, kernel drops are not counted: " << strerror(errno);
+        socket_tuning_.report_rx_overflow = false;
+    }
+}
+
+void Base::countRxOverflow(const struct msghdr& msg, metrics::Direction direction) {
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL) {
+            continue;
+        }
+
+        uint32_t total;
+        memcpy(&total, CMSG_DATA(cmsg), sizeof(total));
+        addRxOverflow(total, direction);
+        return;
+    }
+}
+
+void Base::pollRxOverflow(metrics::Direction direction) {
+
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t length = sizeof(meminfo);
+    if (getsockopt(socket_fd_, SOL_SOCKET, SO_MEMINFO, meminfo, &length) == 0 &&
+        length > SK_MEMINFO_DROPS * sizeof(uint32_t))
+    {
+        addRxOverflow(meminfo[SK_MEMINFO_DROPS], direction);
+    }
+}
+
+void Base::addRxOverflow(uint32_t total, metrics::Direction direction) {
+
+    // a running total that wraps at 2^32, the difference is still right
+    uint32_t dropped = total - rx_overflow_total_;
+    rx_overflow_total_ = total;
+
+    if (dropped > 0)
+    {
+        rx_kernel_drops_.fetch_add(dropped, std::memory_order_relaxed);
+        metrics::Counters::add(direction, metrics::unknown_stream, metrics::Counter::KERNEL_DROPS, dropped);
+        LOG_EVERY_MS(WARNING, logging::default_log_interval_ms) << "Kernel dropped " << dropped
+            << " datagrams on a full receive buffer, fd " << socket_fd_;
+    }
+}
+
+bool Base::enableRxTimestamping() {
+
+    if (rx_timestamping_ == RxTimestamping::SOFTWARE)
+    {
+        int enable = 1;
+        return setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+    }
+
+    // the software stamps cover datagrams the NIC did not stamp
+    int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    return setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+}
+
+bool Base::hardwareStampUsable(const struct timespec& hardware, const struct timespec& software) const {
+
+    if (hardware.tv_sec == 0 && hardware.tv_nsec == 0) {
+        return false;
+    }
+
+    // the raw stamp is in the NIC's own clock; without a software stamp to check it against, or
+    // far off that one, the NIC clock is not synchronized and would make every record look stale
+    uint64_t hardware_ns = (uint64_t)hardware.tv_sec * 1000000000ULL + (uint64_t)hardware.tv_nsec;
+    uint64_t software_ns = (uint64_t)software.tv_sec * 1000000000ULL + (uint64_t)software.tv_nsec;
+    uint64_t skew_ns = hardware_ns > software_ns ? hardware_ns - software_ns : software_ns - hardware_ns;
+
+    if (software_ns == 0 || skew_ns > max_hardware_stamp_skew_ns)
+    {
+        LOG_EVERY_MS(WARNING, logging::default_log_interval_ms) << "NIC clock is " << skew_ns / 1000
+            << " us off CLOCK_REALTIME, using software rx stamps; is phc2sys running?";
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t Base::rxTimestampNs(const struct msghdr& msg, uint64_t monotonic_now_ns, uint64_t realtime_now_ns) const {
+
+    if (rx_timestamping_ == RxTimestamping::NONE) {
+        return monotonic_now_ns;
+    }
+
+    const struct timespec* stamp = nullptr;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            stamp = reinterpret_cast<const struct timespec*>(CMSG_DATA(cmsg));
+        }
+        else if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            // struct scm_timestamping: [0] software, [2] raw hardware
+            const struct timespec* stamps = reinterpret_cast<const struct timespec*>(CMSG_DATA(cmsg));
+            stamp = hardwareStampUsable(stamps[2], stamps[0]) ? &stamps[2] : &stamps[0];
+        }
+    }
+
+    if (!stamp || (stamp->tv_sec == 0 && stamp->tv_nsec == 0)) {
+        return monotonic_now_ns;
+    }
+
+    // kernel stamps are CLOCK_REALTIME, move them by the time since the datagram arrived
+    uint64_t stamp_ns = (uint64_t)stamp->tv_sec * 1000000000ULL + (uint64_t)stamp->tv_nsec;
+    if (stamp_ns >= realtime_now_ns) {
+        return monotonic_now_ns;
+    }
+
+    uint64_t waited_ns = realtime_now_ns - stamp_ns;
+    return waited_ns < monotonic_now_ns ? monotonic_now_ns - waited_ns : monotonic_now_ns;
+}
+
+bool Base::setNonBlocking() {
+
+    int flags = fcntl(socket_fd_, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket_fd_, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        LOG(ERROR) << "Failed to set O_NONBLOCK: " << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+bool Base::setupTxRing() {
+
+    tx_ring_.reset(new UringRing());
+    if (!tx_ring_->init(socket_fd_, max_tx_batch_size))
+    {
+        tx_ring_.reset();
+        return false;
+    }
+
+    return true;
+}
+
+int Base::sendBatch(struct mmsghdr* msgs, unsigned int count, const char* tag, int flags) {
+
+    unsigned int sent = 0;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        msgs[i].msg_hdr.msg_name = &tx_address_;
+        msgs[i].msg_hdr.msg_namelen = sizeof(tx_address_);
+    }
+
+    if (tx_ring_) {
+        return sendBatchUring(msgs, count, tag, flags);
+    }
+
+    while (sent < count)
+    {
+        int msg_count = sendmmsg(socket_fd_, &msgs[sent], count - sent, MSG_CONFIRM | flags);
+        if (msg_count < 0)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            // the first message of the remaining batch failed, drop it and carry on with the rest
+            LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << tag << " sendmmsg: " << strerror(errno);
+            ++sent;
+            continue;
+        }
+
+        sent += msg_count;
+    }
+
+    return sent;
+}
+
+int Base::sendBatchUring(struct mmsghdr* msgs, unsigned int count, const char* tag, int flags) {
+
+    UringCompletion completions[max_tx_batch_size];
+    unsigned int sent = 0;
+
+    while (sent < count)
+    {
+        // linked, so the sends run in order and a failed one cancels those behind it; what is
+        // consumed is always a prefix of the batch, as with sendmmsg
+        unsigned int queued = 0;
+        while (sent + queued < count &&
+               tx_ring_->prepareSendMsg(&msgs[sent + queued].msg_hdr, MSG_CONFIRM | flags, sent + queued,
+                                        sent + queued + 1 < count))
+        {
+            ++queued;
+        }
+
+        if (queued == 0) {
+            break;
+        }
+
+        // with MSG_DONTWAIT a send on a full socket buffer completes at once with -EAGAIN instead
+        // of waiting for room, so waiting for the completions never blocks a non-blocking caller
+        unsigned int completed = 0;
+        unsigned int consumed = 0;
+        bool would_block = false;
+        while (completed < queued)
+        {
+            int submitted = tx_ring_->submit(queued - completed);
+            unsigned int reaped = tx_ring_->takeCompletions(completions, max_tx_batch_size);
+
+            if (submitted < 0 && submitted != -EINTR && submitted != -EBUSY && submitted != -EAGAIN)
+            {
+                LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << tag << " io_uring_enter: " << strerror(-submitted);
+                if (reaped == 0)
+                {
+                    // nothing was taken, so nothing is in flight; the caller keeps the rest
+                    tx_ring_->discardUnsubmitted();
+                    return sent + consumed;
+                }
+            }
+
+            for (unsigned int i = 0; i < reaped; ++i)
+            {
+                unsigned int index = (unsigned int)completions[i].user_data;
+                int res = completions[i].res;
+
+                if (res == -ECANCELED) {
+                    // behind a failed send, the next round queues it again
+                    continue;
+                }
+                if (res == -EAGAIN || res == -EWOULDBLOCK) {
+                    // not sent, the caller retries once the socket is writable
+                    would_block = true;
+                    continue;
+                }
+
+                if (res < 0) {
+                    // like the sendmmsg path, a failed message is dropped and the rest still goes out
+                    LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << tag << " io_uring sendmsg: " << strerror(-res);
+                }
+                else {
+                    msgs[index].msg_len = res;
+                }
+                consumed = std::max(consumed, index + 1 - sent);
+            }
+            completed += reaped;
+        }
+
+        sent += consumed;
+        if (would_block || consumed == 0) {
+            break;
+        }
+    }
+
+    return sent;
+}
+
+void Base::requestRxStop() {
+
+    rx_stop_requested_.store(true, std::memory_order_release);
+
+    // unconnected UDP sockets report ENOTCONN but are shut down and their waiters woken all the same
+    if (socket_fd_ >= 0) {
+        ::shutdown(socket_fd_, SHUT_RD);
+    }
+}
+
+void Base::requestTxStop(uint32_t drain_timeout_ms) {
+
+    tx_stop_deadline_ns_.store(metrics::monotonicNowNs() + (uint64_t)drain_timeout_ms * 1000000, std::memory_order_release);
+}
+
+bool Base::txStopDue(bool idle) const {
+
+    uint64_t deadline_ns = tx_stop_deadline_ns_.load(std::memory_order_acquire);
+    return deadline_ns != 0 && (idle || metrics::monotonicNowNs() >= deadline_ns);
+}
+
 bool Base::shutdown() {
 
-    close(socket_fd_);
+    if (socket_fd_ >= 0) {
+        close(socket_fd_);
+        socket_fd_ = -1;
+    }
 
     return true;
 }
@@ -0,0 +1,178 @@
+#include "bridge_reactor.h"
+#include "logging/log.h"
+#include "metrics/monotonic_clock.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+BridgeReactor::BridgeReactor(MabxData& mabx, TtmData& ttm) : mabx_(mabx),
+                                                           ttm_(ttm),
+                                                           epoll_fd_(-1),
+                                                           stop_fd_(-1),
+                                                           stop_requested_(false),
+                                                           drain_timeout_ms_(default_shutdown_drain_ms),
+                                                           mabx_watching_writable_(false),
+                                                           ttm_watching_writable_(false),
+                                                           thread_tuning_(default_thread_tuning) {
+
+}
+
+bool BridgeReactor::init() {
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        LOG(ERROR) << "Reactor epoll_create1: " << strerror(errno);
+        return false;
+    }
+
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        LOG(ERROR) << "Reactor eventfd: " << strerror(errno);
+        return false;
+    }
+
+    for (int fd : {mabx_.socketFd(), ttm_.socketFd(), stop_fd_}) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            LOG(ERROR) << "Reactor epoll_ctl add fd " << fd << ": " << strerror(errno);
+            return false;
+        }
+    }
+
+    loop_thread_ = std::thread(&BridgeReactor::run, this);
+    applyThreadTuning(loop_thread_, thread_tuning_, "bridge-reactor");
+
+    return true;
+}
+
+void BridgeReactor::run() {
+
+    constexpr int max_events{4};
+    struct epoll_event events[max_events];
+
+    while (!stop_requested_.load(std::memory_order_acquire))
+    {
+        int event_count = epoll_wait(epoll_fd_, events, max_events, -1);
+        if (event_count < 0)
+        {
+            if (errno != EINTR) {
+                LOG(ERROR) << "Reactor epoll_wait: " << strerror(errno);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < event_count; ++i)
+        {
+            if (!(events[i].events & (EPOLLIN | EPOLLERR))) {
+                continue;
+            }
+
+            // level triggered, whatever is left over after the budget is picked up on the next pass
+            if (events[i].data.fd == mabx_.socketFd())
+            {
+                for (int n = 0; n < reactor_rx_budget && mabx_.receiveMabxBatch(MSG_DONTWAIT) > 0; ++n) {}
+            }
+            else if (events[i].data.fd == ttm_.socketFd())
+            {
+                for (int n = 0; n < reactor_rx_budget && ttm_.receiveTtmMessage(MSG_DONTWAIT) > 0; ++n) {}
+            }
+        }
+
+        // everything received in this pass leaves before the loop sleeps again; EPOLLOUT
+        // readiness needs no handling of its own beyond getting here
+        flushTx();
+    }
+
+    drainTx();
+}
+
+void BridgeReactor::drainTx() {
+
+    uint64_t deadline_ns = metrics::monotonicNowNs() + (uint64_t)drain_timeout_ms_ * 1000000;
+
+    while (true)
+    {
+        flushTx();
+        if (!mabx_.txBlocked() && !ttm_.txBlocked()) {
+            // both queues are empty, nothing is received any more to fill them again
+            return;
+        }
+
+        uint64_t now_ns = metrics::monotonicNowNs();
+        if (now_ns >= deadline_ns) {
+            LOG(WARNING) << "Reactor - records still queued after the " << drain_timeout_ms_ << " ms shutdown drain";
+            return;
+        }
+
+        // the sockets stay readable, so wait for writability with poll instead of the epoll set
+        struct pollfd tx_fds[2] = {{mabx_.socketFd(), (short)(mabx_.txBlocked() ? POLLOUT : 0), 0},
+                                   {ttm_.socketFd(), (short)(ttm_.txBlocked() ? POLLOUT : 0), 0}};
+        poll(tx_fds, 2, (int)((deadline_ns - now_ns + 999999) / 1000000));
+    }
+}
+
+void BridgeReactor::flushTx() {
+
+    while (!mabx_.txBlocked() && mabx_.transmitTtmBatch(MSG_DONTWAIT) > 0) {}
+    while (!ttm_.txBlocked() && ttm_.transmitMabxBatch(MSG_DONTWAIT) > 0) {}
+
+    watchWritable(mabx_.socketFd(), mabx_.txBlocked(), mabx_watching_writable_);
+    watchWritable(ttm_.socketFd(), ttm_.txBlocked(), ttm_watching_writable_);
+}
+
+void BridgeReactor::watchWritable(int fd, bool blocked, bool& watching) {
+
+    if (blocked == watching) {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (blocked ? (uint32_t)EPOLLOUT : 0U);
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) < 0) {
+        LOG(ERROR) << "Reactor epoll_ctl mod fd " << fd << ": " << strerror(errno);
+        return;
+    }
+
+    watching = blocked;
+}
+
+bool BridgeReactor::shutdown(uint32_t drain_timeout_ms) {
+
+    if (loop_thread_.joinable()) {
+        drain_timeout_ms_ = drain_timeout_ms;
+        stop_requested_.store(true, std::memory_order_release);
+
+        uint64_t one = 1;
+        if (write(stop_fd_, &one, sizeof(one)) < 0) {
+            LOG(ERROR) << "Reactor stop eventfd write: " << strerror(errno);
+        }
+        loop_thread_.join();
+    }
+
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+
+    if (stop_fd_ >= 0) {
+        close(stop_fd_);
+        stop_fd_ = -1;
+    }
+
+    return true;
+}
+
+BridgeReactor::~BridgeReactor() {
+
+    shutdown();
+}
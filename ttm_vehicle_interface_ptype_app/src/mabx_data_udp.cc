@@ -1,118 +1,736 @@
 #include "mabx_data_udp.h"
 #include "ttm_data_udp.h"
 #include "logging/log.h"
+#include "logging/rate_limited_log.h"
+#include "metrics/monotonic_clock.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+
+MabxData::MabxData() : rx_batch_size_(default_mabx_rx_batch_size),
+                       rx_batch_timeout_ms_(default_mabx_rx_batch_timeout_ms),
+                       reassembler_(metrics::Direction::MABX_TO_TTM),
+                       tx_batch_count_(0),
+                       tx_batch_sent_(0),
+                       tx_chunking_(true),
+                       tx_buffer_(tx_buffer_capacity, metrics::Direction::TTM_TO_MABX),
+                       threading_mode_(ThreadingMode::THREADED),
+                       ttm_(nullptr) {
+
+    // only the newest infrastructure heartbeat and localization are worth sending to a MABX that fell behind
+    tx_buffer_.setStreamPolicy(ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat::STREAM_NUMBER,
+                               QueuePolicy::LATEST_VALUE);
+    tx_buffer_.setStreamPolicy(ParkingInfrastructure::Localization::Streams::Infrastructure::Localization::STREAM_NUMBER,
+                               QueuePolicy::LATEST_VALUE);
+
+    // the vehicle disables automated parking when the infrastructure heartbeat stops, no route may delay it
+    tx_buffer_.setStreamPriority(ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat::STREAM_NUMBER,
+                                 TxPriority::HIGH);
+    tx_buffer_.setStreamPriority(ParkingInfrastructure::Routing::Streams::Infrastructure::Routing::STREAM_NUMBER,
+                                 TxPriority::LOW);
+
+    // after a stall the newest update may itself be too old to be of use
+    tx_buffer_.setStreamMaxAge(ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat::STREAM_NUMBER,
+                               default_heartbeat_max_age_ms);
+    tx_buffer_.setStreamMaxAge(ParkingInfrastructure::Localization::Streams::Infrastructure::Localization::STREAM_NUMBER,
+                               default_localization_max_age_ms);
+}
 
-MabxData::MabxData() : ttm_(std::make_unique<TtmData>()) {
+void MabxData::setPeer(TtmData* ttm) {
 
+    ttm_ = ttm;
 }
 
-bool MabxData::init(int rx_port, const std::string tx_address, int tx_port) {
+void MabxData::setRxBatching(size_t batch_size, int timeout_ms) {
 
-    BaseSocket::init(rx_port, tx_address, tx_port);
+    rx_batch_size_ = batch_size > 0 ? batch_size : 1;
+    rx_batch_timeout_ms_ = timeout_ms > 0 ? timeout_ms : 0;
+}
 
-    rx_thread_ = std::thread(&MabxData::receiveMabxData, this);
+void MabxData::setTxChunking(bool enabled) {
 
-    rx_thread_native_handle_ = rx_thread_.native_handle();
-    rx_thread_.detach();
+    tx_chunking_ = enabled;
+}
 
-    tx_thread_ = std::thread(&MabxData::transmitTtmDataToMabx, this);
+void MabxData::setReassemblyTimeout(uint8_t stream_number, uint32_t timeout_ms) {
+
+    reassembler_.setTimeout(stream_number, timeout_ms);
+}
+
+void MabxData::prefaultTxBuffers(size_t blocks_per_class) {
+
+    tx_buffer_.prefault(blocks_per_class);
+}
+
+uint64_t MabxData::reassemblyDropped() const {
 
-    tx_thread_native_handle_ = tx_thread_.native_handle();
-    tx_thread_.detach();
+    return reassembler_.dropped();
+}
+
+bool MabxData::init(int rx_port, const std::string tx_address, int tx_port, ThreadingMode mode) {
+
+    if (!Base::init(rx_port, tx_address.c_str(), tx_port)) {
+        return false;
+    }
+
+    threading_mode_ = mode;
+    setupRxBatch();
+    setupTxBatch();
+
+    if (mode == ThreadingMode::REACTOR) {
+        // a BridgeReactor drives receiveMabxBatch/transmitTtmBatch from its event loop
+        socket_backend_ = SocketBackend::SYSCALL;
+        return setNonBlocking();
+    }
+
+    if (socket_backend_ == SocketBackend::IO_URING && !(setupRxRing() && setupTxRing()))
+    {
+        LOG(WARNING) << "MUDP - io_uring unavailable, using recvmmsg/sendmmsg";
+        rx_ring_.reset();
+        tx_ring_.reset();
+        socket_backend_ = SocketBackend::SYSCALL;
+    }
+
+    rx_thread_ = std::thread(&MabxData::receiveMabxData, this);
+    applyThreadTuning(rx_thread_, rx_thread_tuning_, "mudp-rx");
+
+    tx_thread_ = std::thread(&MabxData::transmitTtmDataToMabx, this);
+    applyThreadTuning(tx_thread_, tx_thread_tuning_, "mudp-tx");
 
     return true;
 }
 
 void MabxData::receiveMabxData() {
-    
-    while(1)
+
+    if (rx_ring_)
     {
-        UDPRecordBuffer_t data;
+        // returns on a stop request, or if the kernel turns out not to support multishot receive
+        receiveMabxDataUring();
+    }
+
+    while (!rxStopRequested())
+    {
+        // block until at least one datagram is in, then take whatever else is already queued
+        receiveMabxBatch(MSG_WAITFORONE);
+    }
 
-        // receive from mabx
-        int msg_size = recvfrom(socket_fd_, &data, MAXLINE, MSG_WAITALL, (struct sockaddr *) &rx_address_, &ip_address_length_);
+}
+
+void MabxData::setupRxBatch() {
+
+    // the batch is set up once, afterwards only the slots whose record was handed over are refilled
+    rx_batch_records_.assign(rx_batch_size_, nullptr);
+    rx_batch_msgs_.resize(rx_batch_size_);
+    rx_batch_iovecs_.resize(rx_batch_size_);
+    rx_batch_forward_.resize(rx_batch_size_);
+    if (rxControlEnabled()) {
+        rx_batch_control_.resize(rx_batch_size_ * rx_control_size);
+    }
 
-        if (msg_size > 0)
+    for (size_t i = 0; i < rx_batch_size_; ++i)
+    {
+        memset(&rx_batch_msgs_[i], 0, sizeof(struct mmsghdr));
+        rx_batch_msgs_[i].msg_hdr.msg_iov = &rx_batch_iovecs_[i];
+        rx_batch_msgs_[i].msg_hdr.msg_iovlen = 1;
+        if (!rx_batch_control_.empty()) {
+            rx_batch_msgs_[i].msg_hdr.msg_control = &rx_batch_control_[i * rx_control_size];
+        }
+    }
+}
+
+int MabxData::receiveMabxBatch(int flags) {
+
+    refillBatch();
+
+    int msg_count = receiveBatch(0, flags);
+    if (msg_count <= 0)
+    {
+        return msg_count;
+    }
+
+    // top up a partial batch until it is full or the batch timeout expires. The recvmmsg timeout
+    // argument is only checked after a datagram arrives, so the deadline is enforced with poll().
+    // An event loop caller must not block here, it gets the next datagrams on its next wakeup
+    if (rx_batch_timeout_ms_ > 0 && !(flags & MSG_DONTWAIT) && (size_t)msg_count < rx_batch_size_)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(rx_batch_timeout_ms_);
+        struct pollfd rx_poll_fd = {socket_fd_, POLLIN, 0};
+
+        while ((size_t)msg_count < rx_batch_size_)
         {
-            // add to TTM Tx queue
-            if (ttm_) { 
-                ttm_->pushTxBuffer(data); 
+            auto remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>
+                                    (deadline - std::chrono::steady_clock::now()).count();
+            if (remaining_ms <= 0 || poll(&rx_poll_fd, 1, (int)remaining_ms) <= 0)
+            {
+                break;
             }
-            else { 
-                LOG(WARNING) << "ttm object is null, dropping packet from MUDP\n";
+
+            int more = receiveBatch(msg_count, MSG_DONTWAIT);
+            if (more > 0)
+            {
+                msg_count += more;
             }
         }
     }
 
+    forwardBatch(msg_count);
+
+    return msg_count;
 }
 
-void MabxData::transmitTtmDataToMabx() {
+void MabxData::refillBatch() {
 
-    UDPRecordBuffer_t data;
-    static int32_t update_index = 0;
+    for (size_t i = 0; i < rx_batch_size_; ++i)
+    {
+        if (!rx_batch_records_[i] && ttm_)
+        {
+            // receive straight into a block of the TTM Tx queue, the datagram size is unknown up front
+            rx_batch_records_[i] = ttm_->acquireTxBuffer(RACAM_UDP_RECORD_SIZE);
+        }
+
+        if (rx_batch_records_[i])
+        {
+            rx_batch_iovecs_[i].iov_base = rx_batch_records_[i]->wireData();
+            rx_batch_iovecs_[i].iov_len = sizeof(UDPRecord_Header) + rx_batch_records_[i]->capacity;
+        }
+        else
+        {
+            // nowhere to forward to, drain the socket into scratch space and drop
+            rx_batch_iovecs_[i].iov_base = &rx_scratch_;
+            rx_batch_iovecs_[i].iov_len = sizeof(rx_scratch_);
+        }
+
+        // the kernel shrinks msg_controllen to what it wrote
+        if (!rx_batch_control_.empty()) {
+            rx_batch_msgs_[i].msg_hdr.msg_controllen = rx_control_size;
+        }
+    }
+}
+
+int MabxData::receiveBatch(size_t first, int flags) {
+
+    int msg_count = recvmmsg(socket_fd_, &rx_batch_msgs_[first], rx_batch_size_ - first, flags, nullptr);
+    if (msg_count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "MUDP recvmmsg: " << strerror(errno);
+    }
+
+    // once the socket is shut down for reading recvmmsg fills the rest of the batch with empty messages
+    if (msg_count > 0 && rxStopRequested())
+    {
+        int received = 0;
+        while (received < msg_count && rx_batch_msgs_[first + received].msg_len > 0) {
+            ++received;
+        }
+        msg_count = received;
+    }
+
+    // one clock read per call, the datagrams of a batch arrived within the same wakeup unless
+    // the kernel stamped them on arrival
+    if (msg_count > 0)
+    {
+        uint64_t now_ns = metrics::monotonicNowNs();
+        bool kernel_stamps = rx_timestamping_ != RxTimestamping::NONE;
+        uint64_t realtime_now_ns = kernel_stamps ? metrics::realtimeNowNs() : 0;
+
+        for (size_t i = first; i < first + msg_count; ++i)
+        {
+            uint64_t received_ns = rxTimestampNs(rx_batch_msgs_[i].msg_hdr, now_ns, realtime_now_ns);
+            if (kernel_stamps) {
+                rx_socket_delay_.record(now_ns - received_ns);
+            }
+            if (rx_batch_records_[i]) {
+                rx_batch_records_[i]->received_ns = received_ns;
+            }
+        }
+
+        // the drop count is a running total, the newest datagram of the batch has the latest one
+        if (socket_tuning_.report_rx_overflow) {
+            countRxOverflow(rx_batch_msgs_[first + msg_count - 1].msg_hdr, metrics::Direction::MABX_TO_TTM);
+        }
+    }
+
+    return msg_count;
+}
+
+void MabxData::forwardBatch(int msg_count) {
+
+    size_t forward_count = 0;
+
+    for (int i = 0; i < msg_count; ++i)
+    {
+        PooledRecord* record = rx_batch_records_[i];
+
+        // a rejected record stays in its slot and is overwritten by the next receive
+        if (!acceptRecord(record, rx_batch_msgs_[i].msg_len))
+        {
+            continue;
+        }
+
+        // so does a chunk, it is copied into the reassembler
+        if (record->header.streamChunks > 1)
+        {
+            PooledRecord* whole_record = reassembleChunk(record);
+            if (whole_record) {
+                rx_batch_forward_[forward_count++] = whole_record;
+            }
+            continue;
+        }
+
+        rx_batch_forward_[forward_count++] = takeRxRecord(rx_batch_records_[i]);
+    }
+
+    if (forward_count > 0)
+    {
+        ttm_->pushTxBuffers(rx_batch_forward_.data(), forward_count);
+    }
+}
+
+bool MabxData::acceptRecord(const PooledRecord* record, size_t msg_size) {
+
+    // scratch space is shared by the whole batch, the stream of a datagram that landed there is gone
+    uint16_t stream = record && msg_size >= sizeof(UDPRecord_Header) ? record->header.streamNumber
+                                                                      : metrics::unknown_stream;
+    metrics::Counters::add(metrics::Direction::MABX_TO_TTM, stream, metrics::Counter::RX_PACKETS);
+    metrics::Counters::add(metrics::Direction::MABX_TO_TTM, stream, metrics::Counter::RX_BYTES, msg_size);
+
+    if (!record)
+    {
+        metrics::Counters::add(metrics::Direction::MABX_TO_TTM, stream, metrics::Counter::DROPS);
+        LOG_EVERY_MS(WARNING, logging::default_log_interval_ms) << "ttm object is null, dropping packet from MUDP\n";
+        return false;
+    }
+
+    if (msg_size < sizeof(UDPRecord_Header) || record->header.streamDataLen > msg_size - sizeof(UDPRecord_Header))
+    {
+        metrics::Counters::add(metrics::Direction::MABX_TO_TTM, stream, metrics::Counter::PARSE_ERRORS);
+        LOG_EVERY_MS(WARNING, logging::default_log_interval_ms) << "MUDP - dropping malformed record of " << msg_size << " bytes";
+        return false;
+    }
+
+    return true;
+}
+
+PooledRecord* MabxData::reassembleChunk(const PooledRecord* chunk) {
+
+    uint64_t now_ms = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>
+                          (std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    const UDPRecordBuffer_t* whole = reassembler_.add(chunk->header, chunk->payload(), now_ms);
+    if (!whole)
+    {
+        return nullptr;
+    }
+
+    PooledRecord* record = ttm_->acquireTxBuffer(whole->header.streamDataLen);
+    if (!record)
+    {
+        metrics::Counters::add(metrics::Direction::MABX_TO_TTM, whole->header.streamNumber, metrics::Counter::DROPS);
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "MUDP - No pool block for a reassembled record of " << whole->header.streamDataLen << " bytes";
+        return nullptr;
+    }
+
+    // the latency of a chunked record counts from its last chunk
+    record->received_ns = chunk->received_ns;
+    record->header = whole->header;
+    memcpy(record->payload(), whole->payload.data(), whole->header.streamDataLen);
+
+    return record;
+}
+
+PooledRecord* MabxData::takeRxRecord(PooledRecord*& rx_block) {
+
+    // a record that needs the largest size class anyway moves to the TTM Tx queue as it is
+    size_t payload_size = rx_block->header.streamDataLen;
+    PooledRecord* record = payload_size <= record_pool_class_capacities[record_pool_class_count - 2]
+                               ? ttm_->acquireTxBuffer(payload_size) : nullptr;
+    if (!record)
+    {
+        record = rx_block;
+        rx_block = nullptr;
+        return record;
+    }
+
+    // otherwise it is copied into a right-sized block, so a queued heartbeat does not hold
+    // 32 KB, and the rx block is received into again
+    record->received_ns = rx_block->received_ns;
+    record->header = rx_block->header;
+    memcpy(record->payload(), rx_block->payload(), payload_size);
+
+    return record;
+}
+
+bool MabxData::setupRxRing() {
+
+    // every buffer can complete once before the rx thread gets to reap, size the CQ for that
+    rx_ring_.reset(new UringRing());
+    if (!rx_ring_->init(socket_fd_, 4, 2 * uring_rx_buffer_count) ||
+        !rx_ring_->setupBufferRing(uring_rx_buffer_count))
+    {
+        return false;
+    }
+
+    rx_ring_records_.assign(uring_rx_buffer_count, nullptr);
+    rx_ring_completions_.resize(2 * uring_rx_buffer_count);
+    if (rx_batch_forward_.size() < rx_ring_completions_.size()) {
+        rx_batch_forward_.resize(rx_ring_completions_.size());
+    }
+
+    return true;
+}
+
+void MabxData::provideRxBuffer(uint16_t bid) {
+
+    PooledRecord*& record = rx_ring_records_[bid];
+    if (!record && ttm_)
+    {
+        record = ttm_->acquireTxBuffer(RACAM_UDP_RECORD_SIZE);
+    }
+
+    if (record) {
+        rx_ring_->provideBuffer(record->wireData(), sizeof(UDPRecord_Header) + record->capacity, bid);
+    }
+    else {
+        // nowhere to forward to, the datagram lands in scratch space and is dropped
+        rx_ring_->provideBuffer(&rx_scratch_, sizeof(rx_scratch_), bid);
+    }
+}
+
+void MabxData::receiveMabxDataUring() {
+
+    // blocks are acquired here and not in init(), the TTM pool only has one producer thread
+    for (uint16_t bid = 0; bid < uring_rx_buffer_count; ++bid) {
+        provideRxBuffer(bid);
+    }
+    rx_ring_->commitBuffers();
+
+    while (1)
+    {
+        int msg_count = rx_ring_->waitReceive(rx_ring_completions_.data(), rx_ring_completions_.size(),
+                                              uring_rx_wait_timeout_ms);
+        // the wait times out regularly, so a stop request is seen within uring_rx_wait_timeout_ms
+        if (rxStopRequested())
+        {
+            return;
+        }
+
+        if (msg_count < 0)
+        {
+            // the blocks still provided to the ring stay with the TTM pool until shutdown
+            LOG(WARNING) << "MUDP - multishot receive unsupported, falling back to recvmmsg";
+            return;
+        }
+
+        if (msg_count > 0 && socket_tuning_.report_rx_overflow) {
+            pollRxOverflow(metrics::Direction::MABX_TO_TTM);
+        }
+
+        size_t forward_count = 0;
+        uint64_t received_ns = metrics::monotonicNowNs();
+
+        for (int i = 0; i < msg_count; ++i)
+        {
+            uint16_t bid = rx_ring_completions_[i].buffer_id;
+            PooledRecord* record = rx_ring_records_[bid];
+
+            if (acceptRecord(record, rx_ring_completions_[i].res))
+            {
+                record->received_ns = received_ns;
+
+                if (record->header.streamChunks > 1)
+                {
+                    // a chunk is copied into the reassembler and its block provided again
+                    PooledRecord* whole_record = reassembleChunk(record);
+                    if (whole_record) {
+                        rx_batch_forward_[forward_count++] = whole_record;
+                    }
+                }
+                else
+                {
+                    rx_batch_forward_[forward_count++] = takeRxRecord(rx_ring_records_[bid]);
+                }
+            }
+
+            provideRxBuffer(bid);
+        }
+        rx_ring_->commitBuffers();
+
+        if (forward_count > 0)
+        {
+            ttm_->pushTxBuffers(rx_batch_forward_.data(), forward_count);
+        }
+    }
+}
+
+void MabxData::transmitTtmDataToMabx() {
 
     while (1)
     {
         std::cout.flush();
 
-        // get from mabx (this) Tx queue (populated by TTM)
-        if (takeFirstTxBuffer(data))
+        // drain everything currently in the mabx (this) Tx queue (populated by TTM)
+        bool idle = transmitTtmBatch(0) == 0 && !txBlocked();
+        if (txStopDue(idle))
+        {
+            return;
+        }
+
+        if (idle)
+        {
+            tx_buffer_.wait();
+        }
+    }
+
+}
+
+void MabxData::setupTxBatch() {
+
+    // room for a batch of records that all need the maximum number of chunks
+    size_t max_msgs = tx_chunking_ ? max_tx_batch_size * UDP_RECORD_MAX_CHUNKS : max_tx_batch_size;
+
+    tx_batch_.resize(max_tx_batch_size);
+    tx_batch_msgs_.resize(max_msgs);
+    tx_batch_iovecs_.resize(2 * max_msgs);
+    tx_chunk_headers_.resize(max_msgs);
+    tx_batch_msg_records_.resize(max_msgs);
+    tx_batch_count_ = 0;
+    tx_batch_sent_ = 0;
+}
+
+size_t MabxData::transmitTtmBatch(int flags) {
+
+    static int32_t update_index = 0;
+
+    // a batch the socket could not take completely last time goes out before anything new
+    if (tx_batch_sent_ == tx_batch_count_)
+    {
+        tx_batch_sent_ = 0;
+        tx_batch_count_ = 0;
+        size_t record_count = takeTxBuffers(tx_batch_.data(), tx_batch_.size());
+        if (record_count == 0)
         {
-            // transmit to mabx
+            return 0;
+        }
+
+        uint32_t tx_time = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>
+                                        (std::chrono::system_clock::now().time_since_epoch()).count();
+
+        for (size_t i = 0; i < record_count; ++i)
+        {
+            // every record of the batch keeps its own index, exactly as if it was sent on its own
+            PooledRecord& data = *tx_batch_[i];
             data.header.streamRefIndex = update_index;
             data.header.sourceTxCnt = update_index;
-            data.header.sourceTxTime = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>
-                                                    (std::chrono::system_clock::now().time_since_epoch()).count();
+            data.header.sourceTxTime = tx_time;
+            ++update_index;
 
-            int error_number = sendto(socket_fd_, (char*)&data.header, sizeof(data.header) + data.header.streamDataLen,
-                                    MSG_CONFIRM, (const struct sockaddr *) &tx_address_, sizeof(tx_address_));
-            if (error_number < 0)
+            if (!tx_chunking_ || data.wireSize() <= UDP_RECORD_MAX_DATAGRAM)
             {
-                LOG(ERROR) << "MUDP sendto: " << gai_strerror(error_number);
+                // only the header and streamDataLen payload bytes go on the wire
+                tx_batch_iovecs_[2 * tx_batch_count_].iov_base = data.wireData();
+                tx_batch_iovecs_[2 * tx_batch_count_].iov_len = data.wireSize();
+                addTxMessage(1, &data);
+                continue;
             }
 
-            ++update_index;
+            // each chunk is a copy of the header followed by a slice of the payload, which stays in place
+            size_t data_len = data.header.streamDataLen;
+            uint8_t chunk_count = (uint8_t)((data_len + UDP_RECORD_CHUNK_SIZE - 1) / UDP_RECORD_CHUNK_SIZE);
+
+            for (uint8_t chunk = 0; chunk < chunk_count; ++chunk)
+            {
+                size_t offset = (size_t)chunk * UDP_RECORD_CHUNK_SIZE;
+                size_t chunk_size = std::min<size_t>(UDP_RECORD_CHUNK_SIZE, data_len - offset);
+
+                UDPRecord_Header& chunk_header = tx_chunk_headers_[tx_batch_count_];
+                chunk_header = data.header;
+                chunk_header.streamDataLen = (uint16_t)chunk_size;
+                chunk_header.streamChunks = chunk_count;
+                chunk_header.streamChunkIdx = chunk;
+
+                tx_batch_iovecs_[2 * tx_batch_count_].iov_base = &chunk_header;
+                tx_batch_iovecs_[2 * tx_batch_count_].iov_len = sizeof(UDPRecord_Header);
+                tx_batch_iovecs_[2 * tx_batch_count_ + 1].iov_base = data.payload() + offset;
+                tx_batch_iovecs_[2 * tx_batch_count_ + 1].iov_len = chunk_size;
+                addTxMessage(2, chunk == chunk_count - 1 ? &data : nullptr);
+            }
+        }
+    }
+
+    // transmit to mabx
+    size_t sent = sendBatch(&tx_batch_msgs_[tx_batch_sent_], tx_batch_count_ - tx_batch_sent_, "MUDP", flags);
+    recordTxLatency(tx_batch_sent_, sent);
+    countTx(tx_batch_sent_, sent);
 
+    size_t released = 0;
+    for (size_t i = tx_batch_sent_; i < tx_batch_sent_ + sent; ++i)
+    {
+        if (tx_batch_msg_records_[i])
+        {
+            tx_buffer_.release(tx_batch_msg_records_[i]);
+            ++released;
         }
-        
     }
-    
+    tx_batch_sent_ += sent;
 
+    return released;
 }
 
-bool MabxData::takeFirstTxBuffer(UDPRecordBuffer_t& udp_record) {
+void MabxData::addTxMessage(size_t iov_count, PooledRecord* completed_record) {
 
-    if (tx_buffer_.empty()){
-        return false;
+    memset(&tx_batch_msgs_[tx_batch_count_], 0, sizeof(struct mmsghdr));
+    tx_batch_msgs_[tx_batch_count_].msg_hdr.msg_iov = &tx_batch_iovecs_[2 * tx_batch_count_];
+    tx_batch_msgs_[tx_batch_count_].msg_hdr.msg_iovlen = iov_count;
+    tx_batch_msg_records_[tx_batch_count_] = completed_record;
+    ++tx_batch_count_;
+}
+
+void MabxData::recordTxLatency(size_t first, size_t count) {
+
+    uint64_t sent_ns = metrics::monotonicNowNs();
+
+    for (size_t i = first; i < first + count; ++i)
+    {
+        // a record is sent once its last message is
+        const PooledRecord* record = tx_batch_msg_records_[i];
+        if (record && record->received_ns != 0 && sent_ns >= record->received_ns) {
+            tx_latency_.record(record->header.streamNumber, sent_ns - record->received_ns);
+        }
     }
+}
 
-    std::lock_guard<std::mutex> lk(tx_buffer_mutex_);
-    udp_record = tx_buffer_.front();
-    tx_buffer_.pop();
+void MabxData::countTx(size_t first, size_t count) {
 
-    return true;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        // the first iovec of every message is the record header or a chunk header
+        const UDPRecord_Header* header = static_cast<const UDPRecord_Header*>(tx_batch_msgs_[i].msg_hdr.msg_iov[0].iov_base);
+        if (tx_batch_msgs_[i].msg_len == 0) {
+            metrics::Counters::add(metrics::Direction::TTM_TO_MABX, header->streamNumber, metrics::Counter::SEND_ERRORS);
+            continue;
+        }
+
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, header->streamNumber, metrics::Counter::TX_PACKETS);
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, header->streamNumber, metrics::Counter::TX_BYTES,
+                               tx_batch_msgs_[i].msg_len);
+    }
+}
+
+bool MabxData::txBlocked() const {
+
+    return tx_batch_sent_ < tx_batch_count_;
+}
+
+bool MabxData::takeFirstTxBuffer(PooledRecord*& udp_record) {
+
+    return tx_buffer_.pop(&udp_record, 1) == 1;
+}
+
+size_t MabxData::takeTxBuffers(PooledRecord** udp_records, size_t max_count) {
+
+    return tx_buffer_.pop(udp_records, max_count);
+}
+
+void MabxData::releaseTxBuffer(PooledRecord* udp_record) {
+
+    tx_buffer_.release(udp_record);
 }
 
 void MabxData::pushTxBuffer(const UDPRecordBuffer_t& udp_record) {
-    std::lock_guard<std::mutex> lk(tx_buffer_mutex_);
     tx_buffer_.push(udp_record);
+}
+
+PooledRecord* MabxData::acquireTxBuffer(size_t payload_size) {
+    return tx_buffer_.acquire(payload_size);
+}
+
+void MabxData::pushTxBuffer(PooledRecord* udp_record) {
+    tx_buffer_.push(udp_record);
+}
+
+void MabxData::setTxWaitMode(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms) {
+    tx_buffer_.setWaitMode(mode, spin_iterations, max_sleep_ms);
+}
+
+TxWakeup::Stats MabxData::txWakeupStats() const {
+    return tx_buffer_.wakeupStats();
+}
+
+void MabxData::setTxOverflowPolicy(OverflowPolicy policy) {
+    tx_buffer_.setOverflowPolicy(policy);
+}
+
+uint64_t MabxData::txDropped() const {
+    return tx_buffer_.dropped();
+}
+
+bool MabxData::setTxStreamPolicy(uint8_t stream_number, QueuePolicy policy) {
+    return tx_buffer_.setStreamPolicy(stream_number, policy);
+}
+
+uint64_t MabxData::txCoalesced() const {
+    return tx_buffer_.coalesced();
+}
+
+void MabxData::setTxStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms) {
+    tx_buffer_.setStreamMaxAge(stream_number, max_age_ms);
+}
+
+uint64_t MabxData::txExpired() const {
+    return tx_buffer_.expired();
+}
+
+void MabxData::setTxStreamPriority(uint8_t stream_number, TxPriority priority) {
+    tx_buffer_.setStreamPriority(stream_number, priority);
+}
+
+void MabxData::setTxScheduling(TxScheduling scheduling, const std::array<uint32_t, tx_priority_count>& weights) {
+    tx_buffer_.setScheduling(scheduling, weights);
+}
+
+TxQueue::PriorityStats MabxData::txPriorityStats(TxPriority priority) const {
+    return tx_buffer_.priorityStats(priority);
+}
+
+const metrics::StreamLatencyHistograms& MabxData::txLatency() const {
+    return tx_latency_;
+}
 
-    if (tx_buffer_.size() > 1024){
-        tx_buffer_.pop();
+const metrics::LatencyHistogram& MabxData::rxSocketDelay() const {
+    return rx_socket_delay_;
+}
+
+
+
+void MabxData::stopReceiving() {
+
+    requestRxStop();
+    if (rx_thread_.joinable()) {
+        rx_thread_.join();
     }
 }
 
+bool MabxData::shutdown(uint32_t drain_timeout_ms) {
+
+    stopReceiving();
 
+    if (tx_thread_.joinable()) {
+        requestTxStop(drain_timeout_ms);
+        tx_buffer_.interruptWait();
+        tx_thread_.join();
 
-bool MabxData::shutdown() {
+        if (!tx_buffer_.empty()) {
+            LOG(WARNING) << "MUDP - records still queued after the " << drain_timeout_ms << " ms shutdown drain";
+        }
+    }
 
-    BaseSocket::shutdown();
-    pthread_cancel(rx_thread_native_handle_);
-    pthread_cancel(tx_thread_native_handle_);
+    Base::shutdown();
 
     return true;
 }
 
 MabxData::~MabxData() {
 
+    shutdown();
 }
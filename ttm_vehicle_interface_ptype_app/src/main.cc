@@ -1,11 +1,16 @@
+#include <cerrno>
 #include <csignal>
 #include <thread>
 #include "ttm_client_tcp.h"
 #include <iostream>
 #include "logging/log.h"
+#include "logging/binary_log.h"
 
 #include "mabx_data_udp.h"
 #include "ttm_data_udp.h"
+#include "bridge_reactor.h"
+#include "thread_tuning.h"
+#include "metrics/counters.h"
 
 constexpr int32_t port_ttm_initial{54000};
 constexpr int32_t port_dat_fw{5000};
@@ -14,6 +19,32 @@ constexpr char ip_dat_fw[] {"10.0.0.193"};
 constexpr int16_t default_main_sleep_ms{100};
 constexpr char ttm_vehicle_id[] {"199"};
 constexpr int16_t exit_signal{2};
+// THREADED runs a rx and tx thread per socket, REACTOR services both sockets from one event loop
+constexpr ThreadingMode bridge_threading_mode{ThreadingMode::THREADED};
+// IO_URING is opt-in: it stamps records in user space, counts drops by SO_MEMINFO instead of
+// SO_RXQ_OVFL, keeps its rx buffers for the life of the process and slows shutdown by up to
+// uring_rx_wait_timeout_ms. It falls back to SYSCALL on kernels without multishot receive
+constexpr SocketBackend bridge_socket_backend{SocketBackend::SYSCALL};
+// CPU masks and SCHED_FIFO priorities of the bridge threads, {0, 0} leaves a thread to the kernel;
+// e.g. {0x4, 80} keeps a thread on CPU 2 ahead of everything that is not real-time
+constexpr ThreadTuning mabx_rx_thread_tuning{0, 0};
+constexpr ThreadTuning mabx_tx_thread_tuning{0, 0};
+constexpr ThreadTuning ttm_rx_thread_tuning{0, 0};
+constexpr ThreadTuning ttm_tx_thread_tuning{0, 0};
+constexpr ThreadTuning reactor_thread_tuning{0, 0};
+// a MABX routing burst arrives faster than one wakeup of the rx thread drains it, the larger
+// receive buffer holds it; busy polling costs a CPU per socket and stays off. Drops that still
+// happen show up as bridge_kernel_drops
+constexpr SocketTuning mabx_socket_tuning{4 * 1024 * 1024, 1024 * 1024, 0, -1, -1, true};
+constexpr SocketTuning ttm_socket_tuning{1024 * 1024, 1024 * 1024, 0, -1, -1, true};
+// mlockall plus pre-faulted record pools, so no page fault can delay a record once running
+constexpr bool lock_bridge_memory{false};
+// packet, drop and error counters are served here, `socat - UNIX-CONNECT:<path>` prints them
+constexpr char metrics_socket_path[] {"/tmp/ttm_vehicle_interface.metrics"};
+// BLOG records go here, `binary_log_decode <path>` prints them
+constexpr char binary_log_path[] {"/tmp/ttm_vehicle_interface.blog"};
+// the file rotates to <path>.1 at this size, so /tmp holds two of them at most
+constexpr size_t binary_log_max_file_bytes{32 * 1024 * 1024};
 
 volatile sig_atomic_t exitFlag = false;
 
@@ -27,6 +58,9 @@ void signalHandler(int signal) {
 int main(int argc, char** argv) {
     ::signal(SIGINT, signalHandler);
     logging::Logger::initialize();
+    if (!logging::BinaryLog::getInstance().start(binary_log_path, binary_log_max_file_bytes)) {
+        LOG(WARNING) << "Binary log " << binary_log_path << " unavailable: " << strerror(errno);
+    }
     ttmclient::TTMclientTCP ttmStartupClient(port_ttm_initial, ip_ttm);
     while( !ttmStartupClient.connectRequest() ) {
         if (exitFlag) {
@@ -53,18 +87,65 @@ int main(int argc, char** argv) {
     ttmStartupClient.shutdownSocket();
     LOG(INFO) << "Shutdown ttm tcp socket";
 
+    if (lock_bridge_memory) {
+        lockProcessMemory();
+    }
+
     MabxData udp;
     TtmData ttm;
+    BridgeReactor reactor(udp, ttm);
+
+    // each side forwards what it receives to the other side's Tx queue
+    udp.setPeer(&ttm);
+    ttm.setPeer(&udp);
 
-    if (!udp.init(port_dat_fw, ip_dat_fw, port_dat_fw)) {
+    udp.setSocketBackend(bridge_socket_backend);
+    ttm.setSocketBackend(bridge_socket_backend);
+    udp.setSocketTuning(mabx_socket_tuning);
+    ttm.setSocketTuning(ttm_socket_tuning);
+    udp.setThreadTuning(mabx_rx_thread_tuning, mabx_tx_thread_tuning);
+    ttm.setThreadTuning(ttm_rx_thread_tuning, ttm_tx_thread_tuning);
+    reactor.setThreadTuning(reactor_thread_tuning);
+
+    // each side's rx thread pushes into the other side's Tx queue, so both sides are shut down
+    // before either is destroyed, on the error paths as well
+    auto shutdown_bridge = [&]() {
+        reactor.shutdown();
+        // nothing is forwarded once both rx threads are stopped, so each tx thread can empty its queue
+        udp.stopReceiving();
+        ttm.stopReceiving();
+        ttm.shutdown();
+        udp.shutdown();
+        logging::BinaryLog::getInstance().stop();
+    };
+
+    if (lock_bridge_memory) {
+        udp.prefaultTxBuffers();
+        ttm.prefaultTxBuffers();
+    }
+
+    if (!udp.init(port_dat_fw, ip_dat_fw, port_dat_fw, bridge_threading_mode)) {
          LOG(DEBUG) << "MABX init fail: " << std::endl;
+        shutdown_bridge();
         return -1;
     }
 
-    if (!ttm.init(std::stoi(ttm_rx_port), ip_ttm, std::stoi(ttm_rx_port)+1)) {
+    if (!ttm.init(std::stoi(ttm_rx_port), ip_ttm, std::stoi(ttm_rx_port)+1, bridge_threading_mode)) {
         LOG(DEBUG) << "TTM init fail: " << std::endl;
+        shutdown_bridge();
+        return -1;
+    }
+
+    if (bridge_threading_mode == ThreadingMode::REACTOR && !reactor.init()) {
+        LOG(DEBUG) << "Reactor init fail: " << std::endl;
+        shutdown_bridge();
         return -1;
     }
+
+    metrics::CounterServer counter_server;
+    if (!counter_server.start(metrics_socket_path)) {
+        LOG(WARNING) << "Metrics socket " << metrics_socket_path << " unavailable: " << strerror(errno);
+    }
     
            // important -- in lieu of joining other threads here, just keep main thread active indefinitely
     while(1)
@@ -72,8 +153,8 @@ int main(int argc, char** argv) {
         if (exitFlag)
         {
             std::cout << "shutdown" << std::endl;
-            ttm.shutdown();
-            udp.shutdown();
+            counter_server.stop();
+            shutdown_bridge();
             // set LED color back to red
             //led.setColor(0xff,0x00);
             //LED::msExecDelay(100);
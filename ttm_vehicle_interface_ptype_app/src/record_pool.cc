@@ -0,0 +1,153 @@
+#include "record_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+RecordPool::RecordPool(size_t blocks_per_class) : blocks_per_class_(blocks_per_class) {
+
+    for (size_t i = 0; i < record_pool_class_count; ++i) {
+        size_classes_.push_back(std::make_unique<SizeClass>(blocks_per_class));
+        size_classes_.back()->cached.reserve(blocks_per_class);
+    }
+}
+
+PooledRecord* RecordPool::acquire(size_t payload_size) {
+
+    size_t size_class = sizeClassFor(payload_size);
+    if (size_class >= record_pool_class_count) {
+        return nullptr;
+    }
+
+    SizeClass& blocks = *size_classes_[size_class];
+    PooledRecord* record = nullptr;
+
+    if (!blocks.cached.empty()) {
+        record = blocks.cached.back();
+        blocks.cached.pop_back();
+        return record;
+    }
+
+    if (blocks.returned.pop(record)) {
+        return record;
+    }
+
+    return allocate(size_class);
+}
+
+void RecordPool::release(PooledRecord* record) {
+
+    if (!record) {
+        return;
+    }
+
+    SizeClass& blocks = *size_classes_[record->size_class];
+    if (blocks.returned.push(record) == SpscRing<PooledRecord*>::PushResult::REJECTED) {
+        deallocate(record);
+    }
+}
+
+void RecordPool::recycle(PooledRecord* record) {
+
+    if (!record) {
+        return;
+    }
+
+    SizeClass& blocks = *size_classes_[record->size_class];
+    if (blocks.cached.size() < blocks_per_class_) {
+        blocks.cached.push_back(record);
+    }
+    else {
+        deallocate(record);
+    }
+}
+
+void RecordPool::prefault(size_t blocks_per_class) {
+
+    for (size_t size_class = 0; size_class < record_pool_class_count; ++size_class) {
+        SizeClass& blocks = *size_classes_[size_class];
+        while (blocks.cached.size() < std::min(blocks_per_class, blocks_per_class_)) {
+            PooledRecord* record = allocate(size_class);
+            if (!record) {
+                return;
+            }
+            memset(record->payload(), 0, record->capacity);
+            blocks.cached.push_back(record);
+        }
+    }
+}
+
+size_t RecordPool::allocatedBlocks() const {
+
+    size_t total = 0;
+    for (const auto& blocks : size_classes_) {
+        total += blocks->allocated.load(std::memory_order_relaxed);
+    }
+
+    return total;
+}
+
+size_t RecordPool::allocatedBytes() const {
+
+    size_t total = 0;
+    for (size_t i = 0; i < record_pool_class_count; ++i) {
+        total += size_classes_[i]->allocated.load(std::memory_order_relaxed) *
+                 blockSize(record_pool_class_capacities[i]);
+    }
+
+    return total;
+}
+
+size_t RecordPool::blockSize(uint32_t capacity) {
+
+    return offsetof(PooledRecord, header) + sizeof(UDPRecord_Header) + capacity;
+}
+
+size_t RecordPool::sizeClassFor(size_t payload_size) {
+
+    size_t size_class = 0;
+    while (size_class < record_pool_class_count && record_pool_class_capacities[size_class] < payload_size) {
+        ++size_class;
+    }
+
+    return size_class;
+}
+
+PooledRecord* RecordPool::allocate(size_t size_class) {
+
+    void* block = ::operator new(blockSize(record_pool_class_capacities[size_class]), std::nothrow);
+    if (!block) {
+        return nullptr;
+    }
+
+    PooledRecord* record = new (block) PooledRecord();
+    record->size_class = (uint8_t)size_class;
+    record->capacity = record_pool_class_capacities[size_class];
+
+    size_classes_[size_class]->allocated.fetch_add(1, std::memory_order_relaxed);
+
+    return record;
+}
+
+void RecordPool::deallocate(PooledRecord* record) {
+
+    size_classes_[record->size_class]->allocated.fetch_sub(1, std::memory_order_relaxed);
+
+    record->~PooledRecord();
+    ::operator delete(record);
+}
+
+RecordPool::~RecordPool() {
+
+    for (auto& blocks : size_classes_) {
+        PooledRecord* record = nullptr;
+        while (blocks->returned.pop(record)) {
+            deallocate(record);
+        }
+        for (PooledRecord* cached : blocks->cached) {
+            deallocate(cached);
+        }
+        blocks->cached.clear();
+    }
+}
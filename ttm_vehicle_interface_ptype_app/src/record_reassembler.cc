@@ -0,0 +1,136 @@
+#include "record_reassembler.h"
+
+#include <string.h>
+
+RecordReassembler::RecordReassembler(metrics::Direction direction) : slots_(reassembly_slot_count),
+                                                                     dropped_(0),
+                                                                     direction_(direction) {
+
+    for (Slot& slot : slots_) {
+        slot.active = false;
+    }
+    timeout_ms_.fill(default_reassembly_timeout_ms);
+}
+
+void RecordReassembler::setTimeout(uint8_t stream_number, uint32_t timeout_ms) {
+
+    timeout_ms_[stream_number] = timeout_ms;
+}
+
+const UDPRecordBuffer_t* RecordReassembler::add(const UDPRecord_Header& header, const unsigned char* payload,
+                                                uint64_t now_ms) {
+
+    uint8_t chunk_count = header.streamChunks;
+    uint8_t chunk_index = header.streamChunkIdx;
+    size_t chunk_size = header.streamDataLen;
+    size_t offset = (size_t)chunk_index * UDP_RECORD_CHUNK_SIZE;
+    bool last_chunk = chunk_index == chunk_count - 1;
+
+    // every chunk but the last is full, that is what fixes the offset of a chunk
+    if (chunk_count < 2 || chunk_index >= chunk_count || chunk_size == 0 || chunk_size > UDP_RECORD_CHUNK_SIZE ||
+        (!last_chunk && chunk_size != UDP_RECORD_CHUNK_SIZE) || offset + chunk_size > RACAM_UDP_RECORD_SIZE)
+    {
+        metrics::Counters::add(direction_, header.streamNumber, metrics::Counter::PARSE_ERRORS);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Slot* slot = findSlot(header, now_ms);
+    if (slot->record.header.streamChunks != chunk_count)
+    {
+        drop(*slot);
+        return nullptr;
+    }
+
+    uint64_t chunk_bit = 1ULL << (chunk_index % 64);
+    if (slot->received[chunk_index / 64] & chunk_bit)
+    {
+        // duplicate
+        return nullptr;
+    }
+    slot->received[chunk_index / 64] |= chunk_bit;
+    ++slot->received_count;
+
+    memcpy(slot->record.payload.data() + offset, payload, chunk_size);
+    if (last_chunk) {
+        slot->last_chunk_size = (uint16_t)chunk_size;
+    }
+
+    if (slot->received_count < chunk_count)
+    {
+        return nullptr;
+    }
+
+    slot->active = false;
+    slot->record.header.streamDataLen = (uint16_t)((chunk_count - 1) * UDP_RECORD_CHUNK_SIZE + slot->last_chunk_size);
+    slot->record.header.streamChunks = 0;
+    slot->record.header.streamChunkIdx = 0;
+
+    return &slot->record;
+}
+
+RecordReassembler::Slot* RecordReassembler::findSlot(const UDPRecord_Header& header, uint64_t now_ms) {
+
+    Slot* free_slot = nullptr;
+    Slot* oldest_slot = nullptr;
+
+    for (Slot& slot : slots_)
+    {
+        if (slot.active && slot.deadline_ms <= now_ms) {
+            drop(slot);
+        }
+
+        if (!slot.active)
+        {
+            if (!free_slot) {
+                free_slot = &slot;
+            }
+            continue;
+        }
+
+        if (slot.record.header.sourceInfo == header.sourceInfo &&
+            slot.record.header.streamNumber == header.streamNumber)
+        {
+            if (slot.stream_ref_index == header.streamRefIndex) {
+                return &slot;
+            }
+
+            // a newer record of the stream started, the rest of the old one is not coming
+            drop(slot);
+            free_slot = &slot;
+            continue;
+        }
+
+        if (!oldest_slot || slot.started_ms < oldest_slot->started_ms) {
+            oldest_slot = &slot;
+        }
+    }
+
+    Slot* slot = free_slot;
+    if (!slot)
+    {
+        slot = oldest_slot;
+        drop(*slot);
+    }
+
+    slot->active = true;
+    slot->stream_ref_index = header.streamRefIndex;
+    slot->started_ms = now_ms;
+    slot->deadline_ms = now_ms + timeout_ms_[header.streamNumber];
+    slot->received_count = 0;
+    slot->last_chunk_size = 0;
+    slot->received.fill(0);
+    slot->record.header = header;
+
+    return slot;
+}
+
+void RecordReassembler::drop(Slot& slot) {
+
+    if (slot.active)
+    {
+        slot.active = false;
+        metrics::Counters::add(direction_, slot.record.header.streamNumber, metrics::Counter::DROPS);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
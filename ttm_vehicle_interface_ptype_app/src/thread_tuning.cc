@@ -0,0 +1,62 @@
+#include "thread_tuning.h"
+#include "logging/log.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+bool applyThreadTuning(std::thread& thread, const ThreadTuning& tuning, const char* name) {
+
+    pthread_t handle = thread.native_handle();
+    pthread_setname_np(handle, name);
+
+    bool applied = true;
+    if (tuning.cpu_mask != 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (tuning.cpu_mask & (1ULL << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+
+        int error = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+        if (error != 0) {
+            LOG(WARNING) << name << " - cannot pin to CPU mask 0x" << std::hex << tuning.cpu_mask << std::dec
+                         << ": " << strerror(error);
+            applied = false;
+        }
+    }
+
+    if (tuning.fifo_priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = tuning.fifo_priority;
+
+        int error = pthread_setschedparam(handle, SCHED_FIFO, &param);
+        if (error != 0) {
+            LOG(WARNING) << name << " - cannot run under SCHED_FIFO priority " << tuning.fifo_priority
+                         << ": " << strerror(error);
+            applied = false;
+        }
+    }
+
+    return applied;
+}
+
+bool lockProcessMemory() {
+
+    // freed blocks stay in the heap instead of going back to the kernel and faulting in again
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        LOG(WARNING) << "Cannot lock process memory: " << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
@@ -1,252 +1,482 @@
-#pragma once
-
 #include "ttm_data_udp.h"
 #include "mabx_data_udp.h"
+#include "logging/binary_log.h"
 #include "logging/log.h"
+#include "logging/rate_limited_log.h"
+#include "metrics/monotonic_clock.h"
+
+TtmData::TtmData() : tx_buffer_(tx_buffer_capacity, metrics::Direction::MABX_TO_TTM),
+                     tx_batch_count_(0),
+                     tx_batch_sent_(0),
+                     threading_mode_(ThreadingMode::THREADED),
+                     udp_(nullptr) {
+
+    // likewise for the vehicle state forwarded to a TTM backend that fell behind
+    tx_buffer_.setStreamPolicy(ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat::STREAM_NUMBER,
+                               QueuePolicy::LATEST_VALUE);
+    tx_buffer_.setStreamPolicy(ParkingInfrastructure::Localization::Streams::Vehicle::Localization::STREAM_NUMBER,
+                               QueuePolicy::LATEST_VALUE);
+
+    tx_buffer_.setStreamPriority(ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat::STREAM_NUMBER,
+                                 TxPriority::HIGH);
+
+    tx_buffer_.setStreamMaxAge(ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat::STREAM_NUMBER,
+                               default_heartbeat_max_age_ms);
+    tx_buffer_.setStreamMaxAge(ParkingInfrastructure::Localization::Streams::Vehicle::Localization::STREAM_NUMBER,
+                               default_localization_max_age_ms);
+}
 
-TtmData::TtmData() : udp_(std::make_unique<MabxData>()) {
+void TtmData::setPeer(MabxData* udp) {
 
+    udp_ = udp;
 }
 
-bool TtmData::init(int rx_port, const std::string tx_address, int tx_port) {
+void TtmData::prefaultTxBuffers(size_t blocks_per_class) {
+
+    tx_buffer_.prefault(blocks_per_class);
+}
 
-    BaseSocket::init(rx_port, tx_address, tx_port);
+bool TtmData::init(int rx_port, const std::string tx_address, int tx_port, ThreadingMode mode) {
+
+    if (!Base::init(rx_port, tx_address.c_str(), tx_port)) {
+        return false;
+    }
+
+    threading_mode_ = mode;
+    setupTxBatch();
+
+    if (mode == ThreadingMode::REACTOR) {
+        // a BridgeReactor drives receiveTtmMessage/transmitMabxBatch from its event loop
+        socket_backend_ = SocketBackend::SYSCALL;
+        return setNonBlocking();
+    }
+
+    if (socket_backend_ == SocketBackend::IO_URING && !(setupRxRing() && setupTxRing()))
+    {
+        LOG(WARNING) << "TTM - io_uring unavailable, using recvfrom/sendmmsg";
+        rx_ring_.reset();
+        tx_ring_.reset();
+        socket_backend_ = SocketBackend::SYSCALL;
+    }
 
     rx_thread_ = std::thread(&TtmData::receiveTtmData, this);
     //std::thread  rx_thread_(&TtmData::receiveTtmData, this);
-
-    rx_thread_native_handle_ = rx_thread_.native_handle();
-    rx_thread_.detach();
+    applyThreadTuning(rx_thread_, rx_thread_tuning_, "ttm-rx");
 
     tx_thread_ = std::thread(&TtmData::transmitMabxDataToTtm, this);
-
-    tx_thread_native_handle_ = tx_thread_.native_handle();
-    tx_thread_.detach();
+    applyThreadTuning(tx_thread_, tx_thread_tuning_, "ttm-tx");
 
     return true;
 }
 
 void TtmData::receiveTtmData() {
 
-    char data[MAXLINE];
-    
-    while (1)
+    if (rx_ring_)
+    {
+        // returns on a stop request, or if the kernel turns out not to support multishot receive
+        receiveTtmDataUring();
+    }
+
+    while (!rxStopRequested())
     {
         // receive from TTM backend
-        int msg_size = recvfrom(socket_fd_, &data, MAXLINE, MSG_WAITALL, (struct sockaddr *) &rx_address_, &ip_address_length_);
-        if (msg_size > 0)
+        receiveTtmMessage(MSG_WAITALL);
+    }
+
+}
+
+int TtmData::receiveTtmMessage(int flags) {
+
+    struct iovec rx_iovec = {rx_data_, MAXLINE};
+    struct msghdr rx_msg;
+    memset(&rx_msg, 0, sizeof(rx_msg));
+    rx_msg.msg_name = &rx_address_;
+    rx_msg.msg_namelen = sizeof(rx_address_);
+    rx_msg.msg_iov = &rx_iovec;
+    rx_msg.msg_iovlen = 1;
+    if (rxControlEnabled())
+    {
+        rx_msg.msg_control = rx_control_;
+        rx_msg.msg_controllen = sizeof(rx_control_);
+    }
+
+    int msg_size = recvmsg(socket_fd_, &rx_msg, flags);
+    if (msg_size > 0)
+    {
+        uint64_t now_ns = metrics::monotonicNowNs();
+        uint64_t received_ns = now_ns;
+        if (rx_timestamping_ != RxTimestamping::NONE)
         {
-            // convert to UDP record and add to MUDP Tx queue
-            json json_msg = json::parse(std::string(data, msg_size));
-            UDPRecordBuffer_t parsed_data;
-            if (jsonToUdpRecord(json_msg, parsed_data)) // be sure to populate sourceTxTime, streamRefIndex, sourceTxCnt later
-            {
-                if (udp_) {
-                     udp_->pushTxBuffer(parsed_data);
-                }
-                else { 
-                    LOG(WARNING) << "mudp object is null, dropping packet from MUDP\n";
-                }
-            }
+            received_ns = rxTimestampNs(rx_msg, now_ns, metrics::realtimeNowNs());
+            rx_socket_delay_.record(now_ns - received_ns);
+        }
+        if (socket_tuning_.report_rx_overflow) {
+            countRxOverflow(rx_msg, metrics::Direction::TTM_TO_MABX);
         }
+
+        // convert to UDP record and add to MUDP Tx queue
+        jsonToUdpRecord(rx_data_, msg_size, received_ns);
     }
 
+    return msg_size;
 }
 
-void TtmData::transmitMabxDataToTtm() {
+bool TtmData::setupRxRing() {
 
-    UDPRecordBuffer_t parsed_data;
+    rx_ring_.reset(new UringRing());
+    if (!rx_ring_->init(socket_fd_, 4, 2 * uring_rx_buffer_count) ||
+        !rx_ring_->setupBufferRing(uring_rx_buffer_count))
+    {
+        return false;
+    }
 
-    json json_data;
+    rx_ring_buffers_.resize((size_t)uring_rx_buffer_count * MAXLINE);
+    rx_ring_completions_.resize(2 * uring_rx_buffer_count);
+
+    for (uint16_t bid = 0; bid < uring_rx_buffer_count; ++bid) {
+        rx_ring_->provideBuffer(&rx_ring_buffers_[(size_t)bid * MAXLINE], MAXLINE, bid);
+    }
+    rx_ring_->commitBuffers();
+
+    return true;
+}
+
+void TtmData::receiveTtmDataUring() {
+
+    while (1)
+    {
+        int msg_count = rx_ring_->waitReceive(rx_ring_completions_.data(), rx_ring_completions_.size(),
+                                              uring_rx_wait_timeout_ms);
+        // the wait times out regularly, so a stop request is seen within uring_rx_wait_timeout_ms
+        if (rxStopRequested())
+        {
+            return;
+        }
+
+        if (msg_count < 0)
+        {
+            LOG(WARNING) << "TTM - multishot receive unsupported, falling back to recvfrom";
+            return;
+        }
+
+        if (msg_count > 0 && socket_tuning_.report_rx_overflow) {
+            pollRxOverflow(metrics::Direction::TTM_TO_MABX);
+        }
+
+        uint64_t received_ns = metrics::monotonicNowNs();
+
+        for (int i = 0; i < msg_count; ++i)
+        {
+            uint16_t bid = rx_ring_completions_[i].buffer_id;
+            char* msg = &rx_ring_buffers_[(size_t)bid * MAXLINE];
+
+            if (rx_ring_completions_[i].res > 0) {
+                jsonToUdpRecord(msg, rx_ring_completions_[i].res, received_ns);
+            }
+
+            // the message is decoded, the buffer can take the next one
+            rx_ring_->provideBuffer(msg, MAXLINE, bid);
+        }
+        rx_ring_->commitBuffers();
+    }
+}
+
+void TtmData::transmitMabxDataToTtm() {
     
     while (1)
     {
         std::cout.flush();
 
-        // get from TTM (this) Tx queue (populated by mabx)
-        if (takeFirstTxBuffer(parsed_data))
+        // drain everything currently in the TTM (this) Tx queue (populated by mabx)
+        bool idle = transmitMabxBatch(0) == 0 && !txBlocked();
+        if (txStopDue(idle))
+        {
+            return;
+        }
+
+        if (idle)
+        {
+            tx_buffer_.wait();
+        }
+    }
+}
+
+void TtmData::setupTxBatch() {
+
+    tx_batch_.resize(max_tx_batch_size);
+    tx_batch_json_.resize(max_tx_batch_size * ttm_json_max_message_size);
+    tx_batch_msgs_.resize(max_tx_batch_size);
+    tx_batch_iovecs_.resize(max_tx_batch_size);
+    tx_batch_streams_.resize(max_tx_batch_size);
+    tx_batch_received_ns_.resize(max_tx_batch_size);
+    tx_batch_count_ = 0;
+    tx_batch_sent_ = 0;
+}
+
+size_t TtmData::transmitMabxBatch(int flags) {
+
+    // messages the socket could not take completely last time go out before anything new
+    if (tx_batch_sent_ == tx_batch_count_)
+    {
+        tx_batch_sent_ = 0;
+        tx_batch_count_ = 0;
+
+        size_t record_count = takeTxBuffers(tx_batch_.data(), tx_batch_.size());
+        if (record_count == 0)
+        {
+            return 0;
+        }
+
+        for (size_t i = 0; i < record_count; ++i)
         {
-            if (parsed_data.header.sourceInfo == ParkingInfrastructure::StreamSource_e::FUSION_PC)
+            bool bridged = false;
+            if (tx_batch_[i]->header.sourceInfo == ParkingInfrastructure::StreamSource_e::FUSION_PC)
             {
-                // convert to json and transmit to TTM backend
-                json_data = udpRecordToJSON(parsed_data);
-                if (!json_data.is_null())
+                // convert to json, the whole batch goes to the TTM backend in one sendmmsg
+                char* json_data = &tx_batch_json_[tx_batch_count_ * ttm_json_max_message_size];
+                size_t json_size = udpRecordToJSON(*tx_batch_[i], json_data, ttm_json_max_message_size);
+                if (json_size > 0)
                 {
-                    int error_number = sendto(socket_fd_, json_data.dump().c_str(), json_data.dump().length(),
-                                        MSG_CONFIRM, (const struct sockaddr *) &tx_address_, sizeof(tx_address_));
-                    if (error_number < 0) { 
-                        LOG(ERROR) << "TTM sendto: " << gai_strerror(error_number); 
-                    }
+                    tx_batch_iovecs_[tx_batch_count_].iov_base = json_data;
+                    tx_batch_iovecs_[tx_batch_count_].iov_len = json_size;
+
+                    memset(&tx_batch_msgs_[tx_batch_count_], 0, sizeof(struct mmsghdr));
+                    tx_batch_msgs_[tx_batch_count_].msg_hdr.msg_iov = &tx_batch_iovecs_[tx_batch_count_];
+                    tx_batch_msgs_[tx_batch_count_].msg_hdr.msg_iovlen = 1;
+                    tx_batch_streams_[tx_batch_count_] = tx_batch_[i]->header.streamNumber;
+                    tx_batch_received_ns_[tx_batch_count_] = tx_batch_[i]->received_ns;
+                    ++tx_batch_count_;
+                    bridged = true;
                 }
             }
 
+            if (!bridged) {
+                metrics::Counters::add(metrics::Direction::MABX_TO_TTM, tx_batch_[i]->header.streamNumber,
+                                       metrics::Counter::DROPS);
+            }
+
+            // the encoded copy is all the send needs, the record goes back to the pool right away
+            tx_buffer_.release(tx_batch_[i]);
         }
 
+        if (tx_batch_count_ == 0)
+        {
+            // records were taken, just none of them is bridged to the TTM backend
+            return record_count;
+        }
     }
+
+    size_t sent = sendBatch(&tx_batch_msgs_[tx_batch_sent_], tx_batch_count_ - tx_batch_sent_, "TTM", flags);
+    recordTxLatency(tx_batch_sent_, sent);
+    countTx(tx_batch_sent_, sent);
+    tx_batch_sent_ += sent;
+
+    return sent;
 }
 
-bool TtmData::jsonToUdpRecord(const json& json_msg, UDPRecordBuffer_t& parsed_data) {
+void TtmData::recordTxLatency(size_t first, size_t count) {
 
-    parsed_data.header.versionInfo = UDP_RECORD_VERSIONINFO;
-    parsed_data.header.streamChunks = 0;
-    parsed_data.header.streamChunkIdx = 0;
+    uint64_t sent_ns = metrics::monotonicNowNs();
 
-    std::cout.flush();
-    int msg_type = std::stoi((std::string)json_msg["msg_type"]);
-    switch (msg_type)
+    for (size_t i = first; i < first + count; ++i)
     {
-    case message_type::ttm_heartbeat:
-        LOG(INFO) << "TTM - Received Heartbeat\n";
-        namespace Heartbeat = ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat;
-
-        parsed_data.header.sourceInfo = Heartbeat::STREAM_SOURCE;
-        parsed_data.header.streamDataLen = sizeof(Heartbeat::Payload);
-        parsed_data.header.streamNumber = Heartbeat::STREAM_NUMBER;
-        parsed_data.header.streamVersion = Heartbeat::STREAM_VERSION;
-
-        Heartbeat::Payload heartbeat_pay_load;
-        heartbeat_pay_load.timestamp_ms = (uint64_t)std::stoull(std::string(json_msg["timestamp"]));
-        heartbeat_pay_load.vehicleId = (uint64_t)199; // (uint64_t)std::stoull(std::string(json_msg["veh_id"]));
-
-        memcpy(&parsed_data.payload, &heartbeat_pay_load, sizeof(heartbeat_pay_load));
-        break;
-
-    case message_type::ttm_localization:
-        LOG(INFO) << "TTM - Received Localization\n";
-        namespace Localization = ParkingInfrastructure::Localization::Streams::Infrastructure::Localization;
-
-        parsed_data.header.sourceInfo = Localization::STREAM_SOURCE;
-        parsed_data.header.streamDataLen = sizeof(Localization::Payload);
-        parsed_data.header.streamNumber = Localization::STREAM_NUMBER;
-        parsed_data.header.streamVersion = Localization::STREAM_VERSION;
-
-        Localization::Payload loc_pay_load;
-        loc_pay_load.timestamp_ms = (uint64_t)std::stoull(std::string(json_msg["meas_time"]));
-        loc_pay_load.coordinateFrame.coordinateSystem = (ParkingInfrastructure::Localization::Types::CoordinateSystem_e)std::stoi(std::string(json_msg["frame"]));
-        loc_pay_load.coordinateFrame.originZone = (uint32_t)std::stoul(std::string(json_msg["zone"]));
-
-        loc_pay_load.state.x = std::stod(std::string(json_msg["X"]));
-        loc_pay_load.state.y = std::stod(std::string(json_msg["Y"]));
-        loc_pay_load.state.z_m = std::stod(std::string(json_msg["Z"]));
-        loc_pay_load.state.roll_rad = std::stod(std::string(json_msg["roll"]));
-        loc_pay_load.state.pitch_rad = std::stod(std::string(json_msg["pitch"]));
-        loc_pay_load.state.yaw_rad = std::stod(std::string(json_msg["yaw"]));
-
-        loc_pay_load.uncertainty.x = std::stod(std::string(json_msg["var_X"]));
-        loc_pay_load.uncertainty.y = std::stod(std::string(json_msg["var_Y"]));
-        loc_pay_load.uncertainty.z_m2 = std::stod(std::string(json_msg["var_Z"]));
-        loc_pay_load.uncertainty.roll_rad2 = std::stod(std::string(json_msg["var_roll"]));
-        loc_pay_load.uncertainty.pitch_rad2 = std::stod(std::string(json_msg["var_pitch"]));
-        loc_pay_load.uncertainty.yaw_rad2 = std::stod(std::string(json_msg["var_yaw"]));
-
-        memcpy(&parsed_data.payload, &loc_pay_load, sizeof(loc_pay_load));
-        break;
-
-    case message_type::ttm_routing:
-        LOG(INFO) << "TTM - Received Routing\n";
-        namespace Routing = ParkingInfrastructure::Routing::Streams::Infrastructure::Routing;
-
-        parsed_data.header.sourceInfo = Routing::STREAM_SOURCE;
-        parsed_data.header.streamDataLen = sizeof(Routing::Payload);
-        parsed_data.header.streamNumber = Routing::STREAM_NUMBER;
-        parsed_data.header.streamVersion = Routing::STREAM_VERSION;
-
-        Routing::Payload routing_pay_load;
-        routing_pay_load.timestamp_ms = (uint64_t)std::stoull(std::string(json_msg["timestamp"]));
-        routing_pay_load.mode = (ParkingInfrastructure::Routing::Types::Mode_e)std::stoi(std::string(json_msg["mode"]));
-        routing_pay_load.numberOfWaypoints = (uint16_t)std::stoul(std::string(json_msg["N"]));
-        for (uint16_t i = 0; i < routing_pay_load.numberOfWaypoints; i++)
-        {
-            json json_msgChild = json_msg[std::to_string(i)];
-            routing_pay_load.waypoints[i].index = (int32_t)std::stoull(std::string(json_msgChild["index"]));
-            routing_pay_load.waypoints[i].x = std::stod(std::string(json_msgChild["X"]));
-            routing_pay_load.waypoints[i].y = std::stod(std::string(json_msgChild["Y"]));
-            routing_pay_load.waypoints[i].z_m = std::stod(std::string(json_msgChild["Z"]));
-            routing_pay_load.waypoints[i].k = std::stod(std::string(json_msgChild["K"]));;
-            routing_pay_load.waypoints[i].maxSpeed_mps = std::stod(std::string(json_msgChild["speed"]));
-            routing_pay_load.waypoints[i].laneWidthRight_m = std::stod(std::string(json_msgChild["lanewidth_right"]));;
-            routing_pay_load.waypoints[i].laneWidthLeft_m = std::stod(std::string(json_msgChild["lanewidth_left"]));;;
+        if (tx_batch_received_ns_[i] != 0 && sent_ns >= tx_batch_received_ns_[i]) {
+            tx_latency_.record(tx_batch_streams_[i], sent_ns - tx_batch_received_ns_[i]);
         }
-        routing_pay_load.destinationWaypointIndex = (int32_t)std::stoul(std::string(json_msg["dest"]));
+    }
+}
 
-        memcpy(&parsed_data.payload, &routing_pay_load, sizeof(routing_pay_load));
-        break;
+void TtmData::countTx(size_t first, size_t count) {
 
-    default:
-        LOG(ERROR) << "Unrecognized message_type - Failed to parse JSON msg\n";
-        return false;
-    }
+    for (size_t i = first; i < first + count; ++i)
+    {
+        if (tx_batch_msgs_[i].msg_len == 0) {
+            metrics::Counters::add(metrics::Direction::MABX_TO_TTM, tx_batch_streams_[i], metrics::Counter::SEND_ERRORS);
+            continue;
+        }
 
-    return true;
+        metrics::Counters::add(metrics::Direction::MABX_TO_TTM, tx_batch_streams_[i], metrics::Counter::TX_PACKETS);
+        metrics::Counters::add(metrics::Direction::MABX_TO_TTM, tx_batch_streams_[i], metrics::Counter::TX_BYTES,
+                               tx_batch_msgs_[i].msg_len);
+    }
 }
 
-json TtmData::udpRecordToJSON(const UDPRecordBuffer_t& udp_record) {
+bool TtmData::txBlocked() const {
+
+    return tx_batch_sent_ < tx_batch_count_;
+}
 
-    json json_data = {};
+bool TtmData::jsonToUdpRecord(const char* msg, size_t msg_size, uint64_t received_ns) {
 
-    switch (udp_record.header.streamNumber)
+    // fields go straight from the SAX events into the payload structs, no json DOM is built
+    if (!json_decoder_.decode(msg, msg_size))
     {
-    case ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat::STREAM_NUMBER:
-        LOG(INFO) << "MUDP - Received Heartbeat\n";
-        namespace Heartbeat = ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat;
-        Heartbeat::Payload heartbeat_pay_load;
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, metrics::unknown_stream, metrics::Counter::RX_PACKETS);
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, metrics::unknown_stream, metrics::Counter::RX_BYTES, msg_size);
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, metrics::unknown_stream, metrics::Counter::PARSE_ERRORS);
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "TTM - Failed to parse JSON msg of " << msg_size << " bytes: " << json_decoder_.error();
+        return false;
+    }
 
-        memcpy(&heartbeat_pay_load, &udp_record.payload, sizeof(Heartbeat::Payload));
-        json_data["msg_type"] = std::to_string(message_type::vehicle_heartbeat);
-        json_data["timestamp"] = std::to_string(heartbeat_pay_load.timestamp_ms);
-        json_data["veh_id"] = std::to_string(heartbeat_pay_load.vehicleId);
-        json_data["status"] = std::to_string(static_cast<uint8_t>(heartbeat_pay_load.vehicleStatus));
-        break;
-    case ParkingInfrastructure::Routing::Streams::Vehicle::Request::STREAM_NUMBER:
-        LOG(INFO) << "MUDP - Received Reqest\n";
-        namespace Request = ParkingInfrastructure::Routing::Streams::Vehicle::Request;
-        Request::Payload reqPayload;
+    BLOG_EVERY_MS(INFO, logging::default_log_interval_ms, "TTM - Received {} of {} bytes", json_decoder_.streamName(), msg_size);
 
-        memcpy(&reqPayload, &udp_record.payload, sizeof(Request::Payload));
+    uint8_t stream = json_decoder_.header().streamNumber;
+    metrics::Counters::add(metrics::Direction::TTM_TO_MABX, stream, metrics::Counter::RX_PACKETS);
+    metrics::Counters::add(metrics::Direction::TTM_TO_MABX, stream, metrics::Counter::RX_BYTES, msg_size);
 
-        json_data["veh_id"] = std::to_string(199);
-        json_data["type"] = std::to_string(static_cast<uint8_t>(reqPayload.requestType));
-        break;
+    if (!udp_)
+    {
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, stream, metrics::Counter::DROPS);
+        LOG_EVERY_MS(WARNING, logging::default_log_interval_ms) << "mudp object is null, dropping packet from MUDP\n";
+        return false;
+    }
 
-    default:
-        LOG(ERROR) << "Unrecognized message_type - Failed to parse MUDP record\n";
+    // be sure to populate sourceTxTime, streamRefIndex, sourceTxCnt later
+    PooledRecord* record = udp_->acquireTxBuffer(json_decoder_.header().streamDataLen);
+    if (!record)
+    {
+        metrics::Counters::add(metrics::Direction::TTM_TO_MABX, stream, metrics::Counter::DROPS);
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "TTM - No pool block for a record of " << json_decoder_.header().streamDataLen << " bytes";
+        return false;
     }
 
-    return json_data;
+    json_decoder_.writeRecord(*record);
+    record->received_ns = received_ns;
+    udp_->pushTxBuffer(record);
+
+    return true;
 }
 
-bool TtmData::takeFirstTxBuffer(UDPRecordBuffer_t& udp_record) {
+size_t TtmData::udpRecordToJSON(const PooledRecord& udp_record, char* json_data, size_t capacity) {
 
-    if (tx_buffer_.empty()){
-        return false;
+    const char* stream_name = TtmJsonEncoder::streamName(udp_record.header);
+    if (!stream_name)
+    {
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "Unrecognized message_type - Failed to parse MUDP record\n";
+        return 0;
+    }
+    BLOG_EVERY_MS(INFO, logging::default_log_interval_ms, "MUDP - Received {} of {} bytes", stream_name, udp_record.header.streamDataLen);
+
+    size_t json_size = TtmJsonEncoder::encode(udp_record, json_data, capacity);
+    if (json_size == 0) {
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "MUDP - " << stream_name << " record of " << udp_record.header.streamDataLen
+                   << " bytes is too short or its JSON message exceeds " << capacity << " bytes";
     }
 
-    std::lock_guard<std::mutex> lk(tx_buffer_mutex_);
-    udp_record = tx_buffer_.front();
-    tx_buffer_.pop();
+    return json_size;
+}
 
-    return true;
+bool TtmData::takeFirstTxBuffer(PooledRecord*& udp_record) {
+
+    return tx_buffer_.pop(&udp_record, 1) == 1;
+}
+
+size_t TtmData::takeTxBuffers(PooledRecord** udp_records, size_t max_count) {
+
+    return tx_buffer_.pop(udp_records, max_count);
+}
+
+void TtmData::releaseTxBuffer(PooledRecord* udp_record) {
+
+    tx_buffer_.release(udp_record);
 }
 
 void TtmData::pushTxBuffer(const UDPRecordBuffer_t& udp_record) {
-    std::lock_guard<std::mutex> lk(tx_buffer_mutex_);
     tx_buffer_.push(udp_record);
+}
+
+PooledRecord* TtmData::acquireTxBuffer(size_t payload_size) {
+    return tx_buffer_.acquire(payload_size);
+}
+
+void TtmData::pushTxBuffer(PooledRecord* udp_record) {
+    tx_buffer_.push(udp_record);
+}
+
+void TtmData::pushTxBuffers(PooledRecord** udp_records, size_t count) {
+    tx_buffer_.push(udp_records, count);
+}
+
+void TtmData::setTxWaitMode(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms) {
+    tx_buffer_.setWaitMode(mode, spin_iterations, max_sleep_ms);
+}
+
+TxWakeup::Stats TtmData::txWakeupStats() const {
+    return tx_buffer_.wakeupStats();
+}
+
+void TtmData::setTxOverflowPolicy(OverflowPolicy policy) {
+    tx_buffer_.setOverflowPolicy(policy);
+}
+
+uint64_t TtmData::txDropped() const {
+    return tx_buffer_.dropped();
+}
+
+bool TtmData::setTxStreamPolicy(uint8_t stream_number, QueuePolicy policy) {
+    return tx_buffer_.setStreamPolicy(stream_number, policy);
+}
+
+uint64_t TtmData::txCoalesced() const {
+    return tx_buffer_.coalesced();
+}
 
-    /// only keep 1024 buffer in queue
-    if (tx_buffer_.size() > 1024){
-        tx_buffer_.pop();
+void TtmData::setTxStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms) {
+    tx_buffer_.setStreamMaxAge(stream_number, max_age_ms);
+}
+
+uint64_t TtmData::txExpired() const {
+    return tx_buffer_.expired();
+}
+
+void TtmData::setTxStreamPriority(uint8_t stream_number, TxPriority priority) {
+    tx_buffer_.setStreamPriority(stream_number, priority);
+}
+
+void TtmData::setTxScheduling(TxScheduling scheduling, const std::array<uint32_t, tx_priority_count>& weights) {
+    tx_buffer_.setScheduling(scheduling, weights);
+}
+
+TxQueue::PriorityStats TtmData::txPriorityStats(TxPriority priority) const {
+    return tx_buffer_.priorityStats(priority);
+}
+
+const metrics::StreamLatencyHistograms& TtmData::txLatency() const {
+    return tx_latency_;
+}
+
+const metrics::LatencyHistogram& TtmData::rxSocketDelay() const {
+    return rx_socket_delay_;
+}
+
+void TtmData::stopReceiving() {
+
+    requestRxStop();
+    if (rx_thread_.joinable()) {
+        rx_thread_.join();
     }
 }
 
-bool TtmData::shutdown() {
+bool TtmData::shutdown(uint32_t drain_timeout_ms) {
+
+    stopReceiving();
+
+    if (tx_thread_.joinable()) {
+        requestTxStop(drain_timeout_ms);
+        tx_buffer_.interruptWait();
+        tx_thread_.join();
+
+        if (!tx_buffer_.empty()) {
+            LOG(WARNING) << "TTM - records still queued after the " << drain_timeout_ms << " ms shutdown drain";
+        }
+    }
 
-    BaseSocket::shutdown();
-    pthread_cancel(rx_thread_native_handle_);
-    pthread_cancel(tx_thread_native_handle_);
+    Base::shutdown();
 
     return true;
 }
 
 TtmData::~TtmData() {
 
+    shutdown();
 }
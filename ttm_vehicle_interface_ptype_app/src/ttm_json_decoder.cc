@@ -0,0 +1,533 @@
+#include "ttm_json_decoder.h"
+#include "message_type.h"
+
+#include <charconv>
+#include <string.h>
+#include <type_traits>
+
+namespace Heartbeat = ParkingInfrastructure::Enablement::Streams::Infrastructure::Heartbeat;
+namespace Localization = ParkingInfrastructure::Localization::Streams::Infrastructure::Localization;
+namespace Routing = ParkingInfrastructure::Routing::Streams::Infrastructure::Routing;
+
+namespace {
+
+/// the TTM backend sends every value as a string, the whole string must be the number
+template <typename T>
+bool parseNumber(const char* first, const char* last, T& value) {
+    auto result = std::from_chars(first, last, value);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+template <typename Enum>
+bool parseEnum(const char* first, const char* last, Enum& value) {
+    typename std::underlying_type<Enum>::type raw;
+    if (!parseNumber(first, last, raw)) {
+        return false;
+    }
+    value = static_cast<Enum>(raw);
+    return true;
+}
+
+template <size_t Size>
+bool keyIs(const std::string& key, const char (&name)[Size]) {
+    return key.size() == Size - 1 && memcmp(key.data(), name, Size - 1) == 0;
+}
+
+}
+
+// one line per TTM message forwarded to MABX; the msg_type picks the stream and its codec.
+// constexpr here, where the class is complete, so the table is built at compile time
+constexpr std::array<StreamEntry<TtmJsonDecoder::DecodeFn>, TtmJsonDecoder::message_type_table_size>
+    TtmJsonDecoder::ttm_streams_ = makeStreamTable<message_type_table_size, DecodeFn>({
+        bridged<BRIDGED_STREAM(Heartbeat)>(message_type::ttm_heartbeat, "Heartbeat"),
+        bridged<BRIDGED_STREAM(Localization)>(message_type::ttm_localization, "Localization"),
+        bridged<BRIDGED_STREAM(Routing)>(message_type::ttm_routing, "Routing"),
+    });
+
+TtmJsonDecoder::TtmJsonDecoder() : payloads_(), // value initialized, i.e. zeroed
+                                   payload_(nullptr),
+                                   msg_type_(-1),
+                                   stream_name_(nullptr),
+                                   error_(nullptr),
+                                   fields_seen_(0),
+                                   depth_(0),
+                                   skip_depth_(0),
+                                   field_(Field::NONE),
+                                   pending_waypoint_(-1),
+                                   waypoint_(-1),
+                                   waypoint_field_(WaypointField::NONE) {
+
+    memset(&header_, 0, sizeof(header_));
+    memset(waypoint_fields_seen_, 0, sizeof(waypoint_fields_seen_));
+}
+
+bool TtmJsonDecoder::decode(const char* msg, size_t msg_size) {
+
+    payload_ = nullptr;
+    msg_type_ = -1;
+    stream_name_ = nullptr;
+    error_ = nullptr;
+    fields_seen_ = 0;
+    memset(waypoint_fields_seen_, 0, sizeof(waypoint_fields_seen_));
+    depth_ = 0;
+    skip_depth_ = 0;
+    field_ = Field::NONE;
+    pending_waypoint_ = -1;
+    waypoint_ = -1;
+    waypoint_field_ = WaypointField::NONE;
+
+    if (!nlohmann::json::sax_parse(msg, msg + msg_size, this))
+    {
+        if (!error_) {
+            error_ = "invalid JSON";
+        }
+        return false;
+    }
+
+    return finish();
+}
+
+void TtmJsonDecoder::writeRecord(PooledRecord& record) const {
+
+    record.header = header_;
+    memcpy(record.payload(), payload_, header_.streamDataLen);
+}
+
+TtmJsonDecoder::Field TtmJsonDecoder::lookupField(const string_t& key) {
+
+    if (keyIs(key, "msg_type"))  return Field::MSG_TYPE;
+    if (keyIs(key, "timestamp")) return Field::TIMESTAMP;
+    if (keyIs(key, "meas_time")) return Field::MEAS_TIME;
+    if (keyIs(key, "frame"))     return Field::FRAME;
+    if (keyIs(key, "zone"))      return Field::ZONE;
+    if (keyIs(key, "X"))         return Field::X;
+    if (keyIs(key, "Y"))         return Field::Y;
+    if (keyIs(key, "Z"))         return Field::Z;
+    if (keyIs(key, "roll"))      return Field::ROLL;
+    if (keyIs(key, "pitch"))     return Field::PITCH;
+    if (keyIs(key, "yaw"))       return Field::YAW;
+    if (keyIs(key, "var_X"))     return Field::VAR_X;
+    if (keyIs(key, "var_Y"))     return Field::VAR_Y;
+    if (keyIs(key, "var_Z"))     return Field::VAR_Z;
+    if (keyIs(key, "var_roll"))  return Field::VAR_ROLL;
+    if (keyIs(key, "var_pitch")) return Field::VAR_PITCH;
+    if (keyIs(key, "var_yaw"))   return Field::VAR_YAW;
+    if (keyIs(key, "mode"))      return Field::MODE;
+    if (keyIs(key, "N"))         return Field::N;
+    if (keyIs(key, "dest"))      return Field::DEST;
+
+    return Field::NONE;
+}
+
+TtmJsonDecoder::WaypointField TtmJsonDecoder::lookupWaypointField(const string_t& key) {
+
+    if (keyIs(key, "index"))           return WaypointField::INDEX;
+    if (keyIs(key, "X"))               return WaypointField::X;
+    if (keyIs(key, "Y"))               return WaypointField::Y;
+    if (keyIs(key, "Z"))               return WaypointField::Z;
+    if (keyIs(key, "K"))               return WaypointField::K;
+    if (keyIs(key, "speed"))           return WaypointField::SPEED;
+    if (keyIs(key, "lanewidth_right")) return WaypointField::LANEWIDTH_RIGHT;
+    if (keyIs(key, "lanewidth_left"))  return WaypointField::LANEWIDTH_LEFT;
+
+    return WaypointField::NONE;
+}
+
+bool TtmJsonDecoder::null() {
+    return assign(nullptr, nullptr);
+}
+
+bool TtmJsonDecoder::boolean(bool) {
+    return assign(nullptr, nullptr);
+}
+
+bool TtmJsonDecoder::number_integer(number_integer_t val) {
+
+    // plain JSON numbers take the same path as the strings the backend normally sends
+    char text[24];
+    auto result = std::to_chars(text, text + sizeof(text), val);
+    return assign(text, result.ptr);
+}
+
+bool TtmJsonDecoder::number_unsigned(number_unsigned_t val) {
+
+    char text[24];
+    auto result = std::to_chars(text, text + sizeof(text), val);
+    return assign(text, result.ptr);
+}
+
+bool TtmJsonDecoder::number_float(number_float_t, const string_t& s) {
+    return assign(s.data(), s.data() + s.size());
+}
+
+bool TtmJsonDecoder::string(string_t& val) {
+    return assign(val.data(), val.data() + val.size());
+}
+
+bool TtmJsonDecoder::start_object(std::size_t) {
+
+    if (skip_depth_ > 0) {
+        ++skip_depth_;
+        return true;
+    }
+
+    if (depth_ == 0) {
+        depth_ = 1;
+        return true;
+    }
+
+    if (depth_ == 1 && pending_waypoint_ >= 0)
+    {
+        depth_ = 2;
+        waypoint_ = pending_waypoint_;
+        pending_waypoint_ = -1;
+        waypoint_field_ = WaypointField::NONE;
+        return true;
+    }
+
+    // any other nested object is not part of a known message, skip it
+    field_ = Field::NONE;
+    skip_depth_ = 1;
+    return true;
+}
+
+bool TtmJsonDecoder::key(string_t& val) {
+
+    if (skip_depth_ > 0) {
+        return true;
+    }
+
+    if (depth_ == 1)
+    {
+        field_ = lookupField(val);
+        pending_waypoint_ = -1;
+
+        uint16_t index;
+        if (field_ == Field::NONE && parseNumber(val.data(), val.data() + val.size(), index))
+        {
+            if (index >= waypoint_capacity) {
+                return fail("waypoint index out of range");
+            }
+            pending_waypoint_ = index;
+        }
+    }
+    else if (depth_ == 2)
+    {
+        waypoint_field_ = lookupWaypointField(val);
+    }
+
+    return true;
+}
+
+bool TtmJsonDecoder::end_object() {
+
+    if (skip_depth_ > 0) {
+        --skip_depth_;
+        return true;
+    }
+
+    if (depth_ == 2) {
+        waypoint_ = -1;
+    }
+    --depth_;
+
+    return true;
+}
+
+bool TtmJsonDecoder::start_array(std::size_t) {
+
+    if (depth_ == 0) {
+        return fail("message is not a JSON object");
+    }
+
+    field_ = Field::NONE;
+    pending_waypoint_ = -1;
+    ++skip_depth_;
+    return true;
+}
+
+bool TtmJsonDecoder::end_array() {
+
+    --skip_depth_;
+    return true;
+}
+
+bool TtmJsonDecoder::parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+
+    return fail("invalid JSON");
+}
+
+bool TtmJsonDecoder::assign(const char* first, const char* last) {
+
+    if (skip_depth_ > 0) {
+        return true;
+    }
+
+    if (depth_ == 0) {
+        return fail("message is not a JSON object");
+    }
+
+    if (depth_ == 1)
+    {
+        Field field = field_;
+        field_ = Field::NONE;
+
+        if (pending_waypoint_ >= 0) {
+            return fail("waypoint is not an object");
+        }
+
+        // keys the bridge does not forward, like veh_id, are ignored
+        if (field == Field::NONE) {
+            return true;
+        }
+
+        if (!first || !storeField(field, first, last)) {
+            return fail("malformed field value");
+        }
+        fields_seen_ |= fieldBit(field);
+        return true;
+    }
+
+    WaypointField field = waypoint_field_;
+    waypoint_field_ = WaypointField::NONE;
+
+    if (field == WaypointField::NONE) {
+        return true;
+    }
+
+    if (!first || !storeWaypointField(field, first, last)) {
+        return fail("malformed waypoint value");
+    }
+    waypoint_fields_seen_[waypoint_] |= waypointFieldBit(field);
+
+    return true;
+}
+
+bool TtmJsonDecoder::storeField(Field field, const char* first, const char* last) {
+
+    auto& heartbeat = std::get<Heartbeat::Payload>(payloads_);
+    auto& localization = std::get<Localization::Payload>(payloads_);
+    auto& routing = std::get<Routing::Payload>(payloads_);
+
+    uint64_t timestamp_ms;
+    double value;
+
+    switch (field)
+    {
+    case Field::MSG_TYPE:
+        return parseNumber(first, last, msg_type_);
+
+    case Field::TIMESTAMP:
+        // heartbeat and routing share the key
+        if (!parseNumber(first, last, timestamp_ms)) {
+            return false;
+        }
+        heartbeat.timestamp_ms = timestamp_ms;
+        routing.timestamp_ms = timestamp_ms;
+        return true;
+
+    case Field::MEAS_TIME:
+        if (!parseNumber(first, last, timestamp_ms)) {
+            return false;
+        }
+        localization.timestamp_ms = timestamp_ms;
+        return true;
+
+    case Field::FRAME: {
+        ParkingInfrastructure::Localization::Types::CoordinateSystem_e frame;
+        if (!parseEnum(first, last, frame)) {
+            return false;
+        }
+        localization.coordinateFrame.coordinateSystem = frame;
+        return true;
+    }
+
+    case Field::ZONE: {
+        uint32_t zone;
+        if (!parseNumber(first, last, zone)) {
+            return false;
+        }
+        localization.coordinateFrame.originZone = zone;
+        return true;
+    }
+
+    case Field::MODE: {
+        ParkingInfrastructure::Routing::Types::Mode_e mode;
+        if (!parseEnum(first, last, mode)) {
+            return false;
+        }
+        routing.mode = mode;
+        return true;
+    }
+
+    case Field::N: {
+        uint16_t waypoint_count;
+        if (!parseNumber(first, last, waypoint_count) || waypoint_count > waypoint_capacity) {
+            return false;
+        }
+        routing.numberOfWaypoints = waypoint_count;
+        return true;
+    }
+
+    case Field::DEST: {
+        int32_t destination;
+        if (!parseNumber(first, last, destination)) {
+            return false;
+        }
+        routing.destinationWaypointIndex = destination;
+        return true;
+    }
+
+    default:
+        break;
+    }
+
+    // everything else is a localization pose or uncertainty
+    if (!parseNumber(first, last, value)) {
+        return false;
+    }
+
+    switch (field)
+    {
+    case Field::X:         localization.state.x = value; break;
+    case Field::Y:         localization.state.y = value; break;
+    case Field::Z:         localization.state.z_m = value; break;
+    case Field::ROLL:      localization.state.roll_rad = value; break;
+    case Field::PITCH:     localization.state.pitch_rad = value; break;
+    case Field::YAW:       localization.state.yaw_rad = value; break;
+    case Field::VAR_X:     localization.uncertainty.x = value; break;
+    case Field::VAR_Y:     localization.uncertainty.y = value; break;
+    case Field::VAR_Z:     localization.uncertainty.z_m2 = value; break;
+    case Field::VAR_ROLL:  localization.uncertainty.roll_rad2 = value; break;
+    case Field::VAR_PITCH: localization.uncertainty.pitch_rad2 = value; break;
+    case Field::VAR_YAW:   localization.uncertainty.yaw_rad2 = value; break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+bool TtmJsonDecoder::storeWaypointField(WaypointField field, const char* first, const char* last) {
+
+    auto& waypoint = std::get<Routing::Payload>(payloads_).waypoints[waypoint_];
+
+    if (field == WaypointField::INDEX)
+    {
+        int32_t index;
+        if (!parseNumber(first, last, index)) {
+            return false;
+        }
+        waypoint.index = index;
+        return true;
+    }
+
+    double value;
+    if (!parseNumber(first, last, value)) {
+        return false;
+    }
+
+    switch (field)
+    {
+    case WaypointField::X:               waypoint.x = value; break;
+    case WaypointField::Y:               waypoint.y = value; break;
+    case WaypointField::Z:               waypoint.z_m = value; break;
+    case WaypointField::K:               waypoint.k = value; break;
+    case WaypointField::SPEED:           waypoint.maxSpeed_mps = value; break;
+    case WaypointField::LANEWIDTH_RIGHT: waypoint.laneWidthRight_m = value; break;
+    case WaypointField::LANEWIDTH_LEFT:  waypoint.laneWidthLeft_m = value; break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+bool TtmJsonDecoder::finish() {
+
+    if (msg_type_ < 0 || (size_t)msg_type_ >= ttm_streams_.size() || !ttm_streams_[msg_type_].registered) {
+        return fail("unrecognized msg_type");
+    }
+
+    const StreamEntry<DecodeFn>& stream = ttm_streams_[msg_type_];
+    if (!(this->*stream.codec)()) {
+        return false;
+    }
+
+    header_.versionInfo = UDP_RECORD_VERSIONINFO;
+    header_.sourceInfo = (uint8_t)stream.source;
+    header_.streamDataLen = (uint16_t)stream.payload_size;
+    header_.streamNumber = (uint8_t)stream.number;
+    header_.streamVersion = (uint8_t)stream.version;
+    header_.streamChunks = 0;
+    header_.streamChunkIdx = 0;
+    stream_name_ = stream.name;
+
+    return true;
+}
+
+template <typename Binding>
+bool TtmJsonDecoder::decodeStream() {
+
+    auto& payload = std::get<typename Binding::Payload>(payloads_);
+    if (!complete(payload)) {
+        return false;
+    }
+
+    payload_ = &payload;
+    return true;
+}
+
+bool TtmJsonDecoder::complete(Heartbeat::Payload& heartbeat) {
+
+    if (!(fields_seen_ & fieldBit(Field::TIMESTAMP))) {
+        return fail("heartbeat without timestamp");
+    }
+    heartbeat.vehicleId = (uint64_t)199; // veh_id is not taken from the message
+
+    return true;
+}
+
+bool TtmJsonDecoder::complete(Localization::Payload&) {
+
+    const uint32_t localization_fields =
+        fieldBit(Field::MEAS_TIME) | fieldBit(Field::FRAME) | fieldBit(Field::ZONE) |
+        fieldBit(Field::X) | fieldBit(Field::Y) | fieldBit(Field::Z) |
+        fieldBit(Field::ROLL) | fieldBit(Field::PITCH) | fieldBit(Field::YAW) |
+        fieldBit(Field::VAR_X) | fieldBit(Field::VAR_Y) | fieldBit(Field::VAR_Z) |
+        fieldBit(Field::VAR_ROLL) | fieldBit(Field::VAR_PITCH) | fieldBit(Field::VAR_YAW);
+
+    if ((fields_seen_ & localization_fields) != localization_fields) {
+        return fail("localization is missing a field");
+    }
+
+    return true;
+}
+
+bool TtmJsonDecoder::complete(Routing::Payload& routing) {
+
+    const uint32_t routing_fields = fieldBit(Field::TIMESTAMP) | fieldBit(Field::MODE) |
+                                    fieldBit(Field::N) | fieldBit(Field::DEST);
+    const uint8_t waypoint_fields = (uint8_t)((1U << static_cast<uint8_t>(WaypointField::NONE)) - 1);
+
+    if ((fields_seen_ & routing_fields) != routing_fields) {
+        return fail("routing is missing a field");
+    }
+    for (uint16_t i = 0; i < routing.numberOfWaypoints; ++i)
+    {
+        if (waypoint_fields_seen_[i] != waypoint_fields) {
+            return fail("routing waypoint is missing a field");
+        }
+    }
+    // waypoints past N may still hold a longer previous route
+    memset(&routing.waypoints[routing.numberOfWaypoints], 0,
+           (waypoint_capacity - routing.numberOfWaypoints) * sizeof(routing.waypoints[0]));
+
+    return true;
+}
+
+bool TtmJsonDecoder::fail(const char* error) {
+
+    error_ = error;
+    return false;
+}
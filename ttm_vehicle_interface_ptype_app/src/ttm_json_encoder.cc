@@ -0,0 +1,74 @@
+#include "ttm_json_encoder.h"
+#include "json_writer.h"
+#include "stream_registry.h"
+#include "parking_infrastructure_streams.h"
+#include "message_type.h"
+
+#include <string.h>
+
+namespace Heartbeat = ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat;
+namespace Request = ParkingInfrastructure::Routing::Streams::Vehicle::Request;
+
+namespace {
+
+// codecs, one overload per payload type; keys are written in sorted order like json::dump()
+
+void encodeJson(const Heartbeat::Payload& payload, JsonWriter& writer) {
+    writer.field("msg_type", (int)message_type::vehicle_heartbeat);
+    writer.field("status", (unsigned)static_cast<uint8_t>(payload.vehicleStatus));
+    writer.field("timestamp", payload.timestamp_ms);
+    writer.field("veh_id", payload.vehicleId);
+}
+
+void encodeJson(const Request::Payload& payload, JsonWriter& writer) {
+    writer.field("type", (unsigned)static_cast<uint8_t>(payload.requestType));
+    writer.field("veh_id", 199);
+}
+
+using EncodeFn = void (*)(const unsigned char* payload, JsonWriter& writer);
+
+template <typename Binding>
+void encodePayload(const unsigned char* payload, JsonWriter& writer) {
+
+    // record payloads are packed behind the header, copy out before reading the fields
+    typename Binding::Payload fields;
+    memcpy(&fields, payload, sizeof(fields));
+    encodeJson(fields, writer);
+}
+
+template <typename Binding>
+constexpr StreamEntry<EncodeFn> bridged(const char* name) {
+    return makeStreamEntry<Binding, EncodeFn>(Binding::number, name, &encodePayload<Binding>);
+}
+
+/// MABX streams forwarded to the TTM backend, indexed by streamNumber
+constexpr auto mabx_streams = makeStreamTable<stream_table_size, EncodeFn>({
+    bridged<BRIDGED_STREAM(Heartbeat)>("Heartbeat"),
+    bridged<BRIDGED_STREAM(Request)>("Request"),
+});
+
+const StreamEntry<EncodeFn>* lookup(const UDPRecord_Header& header) {
+
+    const StreamEntry<EncodeFn>& entry = mabx_streams[header.streamNumber];
+    return entry.identifies(header) ? &entry : nullptr;
+}
+
+}
+
+const char* TtmJsonEncoder::streamName(const UDPRecord_Header& header) {
+
+    const StreamEntry<EncodeFn>* entry = lookup(header);
+    return entry ? entry->name : nullptr;
+}
+
+size_t TtmJsonEncoder::encode(const PooledRecord& record, char* json_data, size_t capacity) {
+
+    const StreamEntry<EncodeFn>* entry = lookup(record.header);
+    if (!entry || record.header.streamDataLen < entry->payload_size) {
+        return 0;
+    }
+
+    JsonWriter writer(json_data, capacity);
+    entry->codec(record.payload(), writer);
+    return writer.finish();
+}
@@ -0,0 +1,384 @@
+#include "tx_queue.h"
+
+#include "metrics/monotonic_clock.h"
+
+#include <algorithm>
+#include <string.h>
+
+TxQueue::TxQueue(size_t capacity, metrics::Direction direction) : pool_(capacity),
+                                                                  wait_interrupted_(false),
+                                                                  rejected_(0),
+                                                                  direction_(direction),
+                                                                  scheduling_(TxScheduling::STRICT),
+                                                                  weights_(default_tx_priority_weights),
+                                                                  any_max_age_(false),
+                                                                  latest_count_(0),
+                                                                  coalesced_(0),
+                                                                  expired_(0) {
+
+    // the rings share the capacity, a ring rounds its share up to a power of two
+    for (size_t i = 0; i < tx_priority_count; ++i) {
+        size_t ring_capacity = std::max<size_t>(capacity * tx_priority_capacity_quarters[i] / 4, 1);
+        rings_.push_back(std::make_unique<SpscRing<PooledRecord*>>(ring_capacity));
+    }
+
+    stream_priorities_.fill(static_cast<uint8_t>(TxPriority::NORMAL));
+    stream_max_age_ns_.fill(0);
+    stream_slots_.fill(fifo_stream);
+    latest_streams_.fill(0);
+    for (auto& slot : latest_) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+
+    for (PriorityCounters& counters : priority_counters_)
+    {
+        counters.dequeued.store(0, std::memory_order_relaxed);
+        counters.last_wait_ns.store(0, std::memory_order_relaxed);
+        counters.max_wait_ns.store(0, std::memory_order_relaxed);
+        counters.total_wait_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TxQueue::setOverflowPolicy(OverflowPolicy policy) {
+
+    for (auto& ring : rings_) {
+        ring->setOverflowPolicy(policy);
+    }
+}
+
+void TxQueue::setWaitMode(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms) {
+
+    wakeup_.configure(mode, spin_iterations, max_sleep_ms);
+}
+
+bool TxQueue::setStreamPolicy(uint8_t stream_number, QueuePolicy policy) {
+
+    if (policy == QueuePolicy::FIFO)
+    {
+        // the slot stays allocated, it just never fills again
+        stream_slots_[stream_number] = fifo_stream;
+        return true;
+    }
+
+    if (stream_slots_[stream_number] != fifo_stream) {
+        return true;
+    }
+
+    if (latest_count_ == max_latest_value_streams) {
+        return false;
+    }
+
+    latest_streams_[latest_count_] = stream_number;
+    stream_slots_[stream_number] = (uint8_t)latest_count_++;
+    return true;
+}
+
+void TxQueue::setStreamPriority(uint8_t stream_number, TxPriority priority) {
+
+    stream_priorities_[stream_number] = static_cast<uint8_t>(priority);
+}
+
+void TxQueue::setStreamMaxAge(uint8_t stream_number, uint32_t max_age_ms) {
+
+    stream_max_age_ns_[stream_number] = (uint64_t)max_age_ms * 1000000;
+    any_max_age_ = false;
+    for (uint64_t max_age_ns : stream_max_age_ns_) {
+        any_max_age_ |= max_age_ns != 0;
+    }
+}
+
+void TxQueue::setScheduling(TxScheduling scheduling, const std::array<uint32_t, tx_priority_count>& weights) {
+
+    scheduling_ = scheduling;
+    for (size_t i = 0; i < tx_priority_count; ++i) {
+        weights_[i] = std::max<uint32_t>(weights[i], 1);
+    }
+}
+
+TxQueue::PriorityStats TxQueue::priorityStats(TxPriority priority) const {
+
+    size_t index = static_cast<size_t>(priority);
+    const PriorityCounters& counters = priority_counters_[index];
+
+    PriorityStats stats;
+    stats.depth = rings_[index]->size();
+    for (size_t i = 0; i < latest_count_; ++i)
+    {
+        if (stream_priorities_[latest_streams_[i]] == index && latest_[i].load(std::memory_order_relaxed)) {
+            ++stats.depth;
+        }
+    }
+    stats.dequeued = counters.dequeued.load(std::memory_order_relaxed);
+    stats.last_wait_ns = counters.last_wait_ns.load(std::memory_order_relaxed);
+    stats.max_wait_ns = counters.max_wait_ns.load(std::memory_order_relaxed);
+    stats.total_wait_ns = counters.total_wait_ns.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+bool TxQueue::push(const UDPRecordBuffer_t& udp_record) {
+
+    bool queued = enqueue(udp_record);
+    wakeup_.notify();
+
+    return queued;
+}
+
+PooledRecord* TxQueue::acquire(size_t payload_size) {
+
+    PooledRecord* record = pool_.acquire(payload_size);
+    if (record) {
+        // a recycled block still carries the receive time of its previous record
+        record->received_ns = 0;
+    }
+
+    return record;
+}
+
+bool TxQueue::push(PooledRecord* record) {
+
+    bool queued = enqueue(record);
+    wakeup_.notify();
+
+    return queued;
+}
+
+size_t TxQueue::push(PooledRecord** records, size_t count) {
+
+    size_t queued = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (enqueue(records[i])) {
+            ++queued;
+        }
+    }
+
+    // one wakeup for the whole batch
+    wakeup_.notify();
+
+    return queued;
+}
+
+size_t TxQueue::pop(PooledRecord** records, size_t max_count) {
+
+    uint64_t now_ns = metrics::monotonicNowNs();
+    size_t count = 0;
+
+    if (scheduling_ == TxScheduling::STRICT)
+    {
+        for (size_t priority = 0; priority < tx_priority_count && count < max_count; ++priority) {
+            count += popPriority(priority, records + count, max_count - count, now_ns);
+        }
+        return count;
+    }
+
+    // WEIGHTED: rounds over all priorities until the batch is full or nothing is left
+    bool progress = true;
+    while (progress && count < max_count)
+    {
+        progress = false;
+        for (size_t priority = 0; priority < tx_priority_count && count < max_count; ++priority)
+        {
+            size_t taken = popPriority(priority, records + count,
+                                       std::min<size_t>(weights_[priority], max_count - count), now_ns);
+            count += taken;
+            progress |= taken > 0;
+        }
+    }
+
+    return count;
+}
+
+size_t TxQueue::popPriority(size_t priority, PooledRecord** records, size_t max_count, uint64_t now_ns) {
+
+    size_t count = 0;
+
+    // the pending state updates go first, they are the ones that get stale
+    for (size_t i = 0; i < latest_count_ && count < max_count; ++i)
+    {
+        if (stream_priorities_[latest_streams_[i]] != priority || !latest_[i].load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        PooledRecord* record = latest_[i].exchange(nullptr, std::memory_order_acquire);
+        if (record) {
+            records[count++] = record;
+        }
+    }
+
+    count += rings_[priority]->pop(records + count, max_count - count);
+
+    // expired records make room for more: refill until the batch is full or the ring is empty, so
+    // a batch that expired entirely never hides the fresh records queued behind it
+    size_t popped = count;
+    while (any_max_age_ && popped > 0)
+    {
+        count = dropExpired(records, count, now_ns);
+        if (count == max_count) {
+            break;
+        }
+
+        popped = rings_[priority]->pop(records + count, max_count - count);
+        count += popped;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    PriorityCounters& counters = priority_counters_[priority];
+    uint64_t max_wait_ns = counters.max_wait_ns.load(std::memory_order_relaxed);
+    uint64_t total_wait_ns = 0;
+    uint64_t wait_ns = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        wait_ns = now_ns > records[i]->queued_ns ? now_ns - records[i]->queued_ns : 0;
+        total_wait_ns += wait_ns;
+        max_wait_ns = std::max(max_wait_ns, wait_ns);
+    }
+
+    counters.dequeued.fetch_add(count, std::memory_order_relaxed);
+    counters.last_wait_ns.store(wait_ns, std::memory_order_relaxed);
+    counters.max_wait_ns.store(max_wait_ns, std::memory_order_relaxed);
+    counters.total_wait_ns.fetch_add(total_wait_ns, std::memory_order_relaxed);
+
+    return count;
+}
+
+size_t TxQueue::dropExpired(PooledRecord** records, size_t count, uint64_t now_ns) {
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        PooledRecord* record = records[i];
+        uint64_t max_age_ns = stream_max_age_ns_[record->header.streamNumber];
+        uint64_t since_ns = record->received_ns != 0 ? record->received_ns : record->queued_ns;
+
+        if (max_age_ns != 0 && now_ns > since_ns && now_ns - since_ns > max_age_ns)
+        {
+            metrics::Counters::add(direction_, record->header.streamNumber, metrics::Counter::EXPIRED);
+            expired_.fetch_add(1, std::memory_order_relaxed);
+            pool_.release(record);
+            continue;
+        }
+        records[kept++] = record;
+    }
+
+    return kept;
+}
+
+void TxQueue::release(PooledRecord* record) {
+
+    pool_.release(record);
+}
+
+bool TxQueue::wait() {
+
+    return wakeup_.wait([this]() { return wait_interrupted_.load(std::memory_order_relaxed) || !empty(); });
+}
+
+void TxQueue::interruptWait() {
+
+    // set before notify() so a waiter that misses the wakeup sees it on its final check
+    wait_interrupted_.store(true, std::memory_order_relaxed);
+    wakeup_.notify();
+}
+
+bool TxQueue::empty() const {
+
+    for (size_t i = 0; i < latest_count_; ++i)
+    {
+        if (latest_[i].load(std::memory_order_relaxed)) {
+            return false;
+        }
+    }
+
+    for (const auto& ring : rings_)
+    {
+        if (!ring->empty()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint64_t TxQueue::dropped() const {
+
+    uint64_t dropped = rejected_.load(std::memory_order_relaxed);
+    for (const auto& ring : rings_) {
+        dropped += ring->dropped();
+    }
+
+    return dropped;
+}
+
+bool TxQueue::enqueue(PooledRecord* record) {
+
+    record->queued_ns = metrics::monotonicNowNs();
+
+    uint8_t slot = stream_slots_[record->header.streamNumber];
+    if (slot != fifo_stream)
+    {
+        // an update the consumer has not taken yet is stale now, and still owned by this side
+        PooledRecord* superseded = latest_[slot].exchange(record, std::memory_order_acq_rel);
+        if (superseded)
+        {
+            metrics::Counters::add(direction_, superseded->header.streamNumber, metrics::Counter::COALESCED);
+            pool_.recycle(superseded);
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    PooledRecord* evicted = nullptr;
+    auto result = rings_[stream_priorities_[record->header.streamNumber]]->push(record, &evicted);
+
+    // the producer owns whatever the ring gave back, recycle it on this side of the pool
+    if (result == SpscRing<PooledRecord*>::PushResult::EVICTED_OLDEST) {
+        metrics::Counters::add(direction_, evicted->header.streamNumber, metrics::Counter::DROPS);
+        pool_.recycle(evicted);
+    }
+    else if (result == SpscRing<PooledRecord*>::PushResult::REJECTED) {
+        metrics::Counters::add(direction_, record->header.streamNumber, metrics::Counter::DROPS);
+        pool_.recycle(record);
+        return false;
+    }
+
+    return true;
+}
+
+bool TxQueue::enqueue(const UDPRecordBuffer_t& udp_record) {
+
+    PooledRecord* record = nullptr;
+    if (udp_record.header.streamDataLen <= udp_record.payload.size()) {
+        record = pool_.acquire(udp_record.header.streamDataLen);
+    }
+
+    if (!record) {
+        metrics::Counters::add(direction_, udp_record.header.streamNumber, metrics::Counter::DROPS);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    record->received_ns = 0;
+    record->header = udp_record.header;
+    memcpy(record->payload(), udp_record.payload.data(), udp_record.header.streamDataLen);
+
+    return enqueue(record);
+}
+
+TxQueue::~TxQueue() {
+
+    // hand queued blocks back before the pool frees its memory
+    PooledRecord* record = nullptr;
+    for (auto& ring : rings_)
+    {
+        while (ring->pop(&record, 1) == 1) {
+            pool_.release(record);
+        }
+    }
+    for (auto& slot : latest_) {
+        pool_.release(slot.exchange(nullptr));
+    }
+}
@@ -0,0 +1,121 @@
+#include "tx_wakeup.h"
+#include "logging/log.h"
+#include "logging/rate_limited_log.h"
+#include "metrics/monotonic_clock.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+TxWakeup::TxWakeup() : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+                       mode_(TxWaitMode::HYBRID),
+                       spin_iterations_(default_tx_wait_spin_iterations),
+                       max_sleep_ms_(default_tx_wait_max_sleep_ms),
+                       sleeping_(false),
+                       notify_time_ns_(0),
+                       sleeps_(0),
+                       wakeups_(0),
+                       timeouts_(0),
+                       last_latency_ns_(0),
+                       max_latency_ns_(0),
+                       total_latency_ns_(0) {
+
+    if (event_fd_ < 0) {
+        // without an eventfd the waiter can only poll, fall back to spinning
+        LOG(ERROR) << "TxWakeup eventfd: " << strerror(errno);
+        mode_ = TxWaitMode::BUSY_SPIN;
+    }
+}
+
+void TxWakeup::configure(TxWaitMode mode, uint32_t spin_iterations, int max_sleep_ms) {
+
+    mode_ = event_fd_ >= 0 ? mode : TxWaitMode::BUSY_SPIN;
+    spin_iterations_ = spin_iterations;
+    max_sleep_ms_ = max_sleep_ms > 0 ? max_sleep_ms : default_tx_wait_max_sleep_ms;
+}
+
+void TxWakeup::notify() {
+
+    // the record must be visible before we look at the waiter, pairs with the fence in wait()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!sleeping_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // only the first producer after the waiter fell asleep pays for the syscall
+    if (sleeping_.exchange(false, std::memory_order_acq_rel)) {
+        notify_time_ns_.store(metrics::monotonicNowNs(), std::memory_order_relaxed);
+
+        uint64_t one = 1;
+        if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "TxWakeup write: " << strerror(errno);
+        }
+    }
+}
+
+void TxWakeup::sleep() {
+
+    sleeps_.fetch_add(1, std::memory_order_relaxed);
+
+    struct pollfd wake_fd = {event_fd_, POLLIN, 0};
+    int ready = poll(&wake_fd, 1, max_sleep_ms_);
+
+    if (ready <= 0) {
+        timeouts_.fetch_add(1, std::memory_order_relaxed);
+        cancelSleep();
+        return;
+    }
+
+    uint64_t latency_ns = metrics::monotonicNowNs() - notify_time_ns_.load(std::memory_order_relaxed);
+
+    drain();
+
+    wakeups_.fetch_add(1, std::memory_order_relaxed);
+    last_latency_ns_.store(latency_ns, std::memory_order_relaxed);
+    total_latency_ns_.fetch_add(latency_ns, std::memory_order_relaxed);
+    if (latency_ns > max_latency_ns_.load(std::memory_order_relaxed)) {
+        max_latency_ns_.store(latency_ns, std::memory_order_relaxed);
+    }
+}
+
+void TxWakeup::cancelSleep() {
+
+    // a producer that already claimed the wakeup is about to write the eventfd; consume that write
+    // here, left in the eventfd it would end the next sleep at once with a stale notify time
+    if (!sleeping_.exchange(false, std::memory_order_acq_rel)) {
+        struct pollfd wake_fd = {event_fd_, POLLIN, 0};
+        poll(&wake_fd, 1, max_sleep_ms_);
+        drain();
+    }
+}
+
+void TxWakeup::drain() {
+
+    uint64_t count;
+    if (read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "TxWakeup read: " << strerror(errno);
+    }
+}
+
+TxWakeup::Stats TxWakeup::stats() const {
+
+    Stats stats;
+    stats.sleeps = sleeps_.load(std::memory_order_relaxed);
+    stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+    stats.timeouts = timeouts_.load(std::memory_order_relaxed);
+    stats.last_latency_ns = last_latency_ns_.load(std::memory_order_relaxed);
+    stats.max_latency_ns = max_latency_ns_.load(std::memory_order_relaxed);
+    stats.total_latency_ns = total_latency_ns_.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+TxWakeup::~TxWakeup() {
+
+    if (event_fd_ >= 0) {
+        close(event_fd_);
+    }
+}
@@ -0,0 +1,390 @@
+#include "uring_ring.h"
+#include "logging/log.h"
+#include "logging/rate_limited_log.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef TTM_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// user_data of the multishot receive, sends use their message index
+constexpr uint64_t receive_user_data{~0ULL};
+
+int uringSetup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int uringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+int uringRegister(int ring_fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+}
+
+UringRing::UringRing() : ring_fd_(-1),
+                         ring_memory_(MAP_FAILED),
+                         ring_memory_size_(0),
+                         sqes_(nullptr),
+                         sqes_size_(0),
+                         sq_head_(nullptr),
+                         sq_tail_(nullptr),
+                         sq_mask_(0),
+                         sq_entries_(0),
+                         sqe_tail_(0),
+                         cq_head_(nullptr),
+                         cq_tail_(nullptr),
+                         cq_mask_(0),
+                         cqes_(nullptr),
+                         buffer_ring_(nullptr),
+                         buffer_ring_size_(0),
+                         buffer_mask_(0),
+                         buffer_tail_(0),
+                         receive_armed_(false),
+                         receive_completed_(false),
+                         buffer_exhausted_(0) {
+
+}
+
+bool UringRing::init(int socket_fd, unsigned sq_entries, unsigned cq_entries) {
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (cq_entries > 0) {
+        params.flags |= IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+    }
+
+    ring_fd_ = uringSetup(sq_entries, &params);
+    if (ring_fd_ < 0)
+    {
+        LOG(WARNING) << "io_uring_setup: " << strerror(errno);
+        return false;
+    }
+
+    // one mmap for both rings, no dropped completions and timed waits, all in 5.11 and later
+    const uint32_t required_features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required_features) != required_features)
+    {
+        LOG(WARNING) << "io_uring is missing required features: " << std::hex << params.features;
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring_memory_size_ = sq_size > cq_size ? sq_size : cq_size;
+    ring_memory_ = mmap(nullptr, ring_memory_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_SQ_RING);
+    if (ring_memory_ == MAP_FAILED)
+    {
+        LOG(ERROR) << "io_uring mmap rings: " << strerror(errno);
+        return false;
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG(ERROR) << "io_uring mmap sqes: " << strerror(errno);
+        sqes_size_ = 0;
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* rings = static_cast<char*>(ring_memory_);
+    sq_head_ = reinterpret_cast<unsigned*>(rings + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(rings + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(rings + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sqe_tail_ = *sq_tail_;
+
+    // sqes are always used in ring order, so the index array is an identity map set up once
+    unsigned* sq_array = reinterpret_cast<unsigned*>(rings + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i) {
+        sq_array[i] = i;
+    }
+
+    cq_head_ = reinterpret_cast<unsigned*>(rings + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(rings + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(rings + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(rings + params.cq_off.cqes);
+
+    if (uringRegister(ring_fd_, IORING_REGISTER_FILES, &socket_fd, 1) < 0)
+    {
+        LOG(WARNING) << "io_uring register socket: " << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+bool UringRing::setupBufferRing(uint16_t entries) {
+
+    if (entries == 0 || (entries & (entries - 1)) != 0)
+    {
+        LOG(ERROR) << "io_uring buffer ring size must be a power of two: " << entries;
+        return false;
+    }
+
+    // the kernel reads the ring directly, it has to be page aligned
+    buffer_ring_size_ = entries * sizeof(struct io_uring_buf);
+    void* memory = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        LOG(ERROR) << "io_uring mmap buffer ring: " << strerror(errno);
+        buffer_ring_size_ = 0;
+        return false;
+    }
+    buffer_ring_ = static_cast<struct io_uring_buf_ring*>(memory);
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(memory);
+    registration.ring_entries = entries;
+    registration.bgid = 0;
+
+    if (uringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+        // provided buffer rings need 5.19
+        LOG(WARNING) << "io_uring register buffer ring: " << strerror(errno);
+        return false;
+    }
+
+    buffer_mask_ = entries - 1;
+    buffer_tail_ = 0;
+
+    return true;
+}
+
+void UringRing::provideBuffer(void* addr, uint32_t length, uint16_t bid) {
+
+    // entries start at offset 0, in C++ the empty struct of __DECLARE_FLEX_ARRAY shifts bufs[] past that
+    struct io_uring_buf* buffer = reinterpret_cast<struct io_uring_buf*>(buffer_ring_) + (buffer_tail_ & buffer_mask_);
+    buffer->addr = reinterpret_cast<uint64_t>(addr);
+    buffer->len = length;
+    buffer->bid = bid;
+    ++buffer_tail_;
+}
+
+void UringRing::commitBuffers() {
+
+    __atomic_store_n(&buffer_ring_->tail, buffer_tail_, __ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe* UringRing::nextSqe() {
+
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+        return nullptr;
+    }
+
+    struct io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+bool UringRing::prepareSendMsg(const struct msghdr* msg, int flags, uint64_t user_data, bool link) {
+
+    struct io_uring_sqe* sqe = nextSqe();
+    if (!sqe) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->flags = IOSQE_FIXED_FILE | (link ? IOSQE_IO_LINK : 0);
+    sqe->fd = 0;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = (uint32_t)flags;
+    sqe->user_data = user_data;
+
+    return true;
+}
+
+void UringRing::armReceive() {
+
+    struct io_uring_sqe* sqe = nextSqe();
+    if (!sqe) {
+        return;
+    }
+
+    // one request delivers every datagram, each into the next buffer of the buffer ring
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->fd = 0;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = 0;
+    sqe->user_data = receive_user_data;
+
+    receive_armed_ = true;
+}
+
+int UringRing::submit(unsigned wait_count, int timeout_ms) {
+
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    unsigned to_submit = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    unsigned flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec timeout;
+    struct io_uring_getevents_arg wait_arg;
+    void* arg = nullptr;
+    size_t arg_size = 0;
+
+    if (wait_count > 0 && timeout_ms >= 0)
+    {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+
+        memset(&wait_arg, 0, sizeof(wait_arg));
+        wait_arg.sigmask_sz = _NSIG / 8;
+        wait_arg.ts = reinterpret_cast<uint64_t>(&timeout);
+
+        flags |= IORING_ENTER_EXT_ARG;
+        arg = &wait_arg;
+        arg_size = sizeof(wait_arg);
+    }
+
+    int submitted = uringEnter(ring_fd_, to_submit, wait_count, flags, arg, arg_size);
+
+    return submitted < 0 ? -errno : submitted;
+}
+
+void UringRing::discardUnsubmitted() {
+
+    // without SQPOLL the kernel only takes entries inside io_uring_enter, nothing races with this
+    sqe_tail_ = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+}
+
+unsigned UringRing::takeCompletions(UringCompletion* completions, unsigned max_count) {
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+
+    while (head != tail && count < max_count)
+    {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        UringCompletion& completion = completions[count++];
+        completion.user_data = cqe.user_data;
+        completion.res = cqe.res;
+        completion.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        completion.has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+        completion.buffer_id = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        ++head;
+    }
+
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+int UringRing::waitReceive(UringCompletion* completions, unsigned max_count, int timeout_ms) {
+
+    if (!receive_armed_) {
+        armReceive();
+    }
+
+    int submitted = submit(1, timeout_ms);
+    if (submitted < 0 && submitted != -ETIME && submitted != -EINTR && submitted != -EBUSY)
+    {
+        LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "io_uring_enter: " << strerror(-submitted);
+    }
+
+    unsigned count = takeCompletions(completions, max_count);
+    unsigned datagrams = 0;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        UringCompletion& completion = completions[i];
+        if (completion.user_data != receive_user_data) {
+            continue;
+        }
+
+        if (!completion.more) {
+            // terminated, the next call arms a new request
+            receive_armed_ = false;
+        }
+
+        if (completion.res < 0)
+        {
+            if (completion.res == -ENOBUFS) {
+                ++buffer_exhausted_;
+            }
+            else if (completion.res == -EINVAL && !receive_completed_) {
+                // multishot receive needs 6.0
+                return -1;
+            }
+            else {
+                LOG_EVERY_MS(ERROR, logging::default_log_interval_ms) << "io_uring recv: " << strerror(-completion.res);
+            }
+            continue;
+        }
+
+        receive_completed_ = true;
+        if (completion.has_buffer) {
+            completions[datagrams++] = completion;
+        }
+    }
+
+    return (int)datagrams;
+}
+
+UringRing::~UringRing() {
+
+    if (buffer_ring_) {
+        munmap(buffer_ring_, buffer_ring_size_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (ring_memory_ != MAP_FAILED) {
+        munmap(ring_memory_, ring_memory_size_);
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+}
+
+#else
+
+// built without io_uring support, init() fails and the callers stay on recvmmsg/sendmmsg
+
+UringRing::UringRing() : ring_fd_(-1), buffer_ring_(nullptr), buffer_exhausted_(0) {
+
+}
+
+bool UringRing::init(int, unsigned, unsigned) {
+
+    LOG(WARNING) << "built without io_uring support";
+    return false;
+}
+
+bool UringRing::setupBufferRing(uint16_t) { return false; }
+void UringRing::provideBuffer(void*, uint32_t, uint16_t) {}
+void UringRing::commitBuffers() {}
+bool UringRing::prepareSendMsg(const struct msghdr*, int, uint64_t, bool) { return false; }
+void UringRing::discardUnsubmitted() {}
+int UringRing::submit(unsigned, int) { return -ENOSYS; }
+unsigned UringRing::takeCompletions(UringCompletion*, unsigned) { return 0; }
+int UringRing::waitReceive(UringCompletion*, unsigned, int) { return -1; }
+
+UringRing::~UringRing() {
+
+}
+
+#endif
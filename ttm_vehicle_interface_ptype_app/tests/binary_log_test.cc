@@ -0,0 +1,138 @@
+#include "logging/binary_log.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class Color : uint8_t { RED = 3 };
+
+constexpr char log_path[] {"binary_log_test.blog"};
+constexpr char rotated_log_path[] {"binary_log_test.blog.1"};
+
+std::string decoder_path;
+
+/// message parts of the decoded lines, everything after "T<thread>: "
+std::vector<std::string> decode(const std::string& path) {
+
+    std::vector<std::string> messages;
+    std::string command = decoder_path + " " + path;
+    FILE* output = popen(command.c_str(), "r");
+    if (!output) {
+        return messages;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), output)) {
+        std::string text(line);
+        size_t start = text.find("] T");
+        start = start == std::string::npos ? std::string::npos : text.find(": ", start);
+        messages.push_back(start == std::string::npos ? text : text.substr(start + 2));
+        if (!messages.back().empty() && messages.back().back() == '\n') {
+            messages.back().pop_back();
+        }
+    }
+    EXPECT_EQ(0, pclose(output));
+    return messages;
+}
+
+size_t countUnknown(const std::vector<std::string>& messages) {
+
+    size_t unknown = 0;
+    for (const std::string& message : messages) {
+        unknown += message.find("UNKNOWN") != std::string::npos;
+    }
+    return unknown;
+}
+
+void argumentsRoundTrip() {
+
+    logging::BinaryLog& log = logging::BinaryLog::getInstance();
+    EXPECT_TRUE(log.start(log_path));
+
+    std::string text = "hello";
+    BLOG(INFO, "int {} uint {} i64 {} u64 {} dbl {} str {} cstr {} enum {}",
+         -5, 7u, (int64_t)-1, (uint64_t)1 << 40, 2.5, text, "lit", Color::RED);
+    BLOG(WARNING, "no args");
+    BLOG(INFO, "MUDP - Received {} of {} bytes", "Heartbeat", 24);
+    log.stop();
+
+    std::vector<std::string> messages = decode(log_path);
+    EXPECT_EQ(3u, messages.size());
+    if (messages.size() == 3) {
+        EXPECT_EQ(std::string("int -5 uint 7 i64 -1 u64 1099511627776 dbl 2.5 str hello cstr lit enum 3"), messages[0]);
+        EXPECT_EQ(std::string("no args"), messages[1]);
+        EXPECT_EQ(std::string("MUDP - Received Heartbeat of 24 bytes"), messages[2]);
+    }
+}
+
+template <int N>
+void firstUse() {
+    BLOG(INFO, "site {}", N);
+}
+
+template <int... N>
+void firstUseOfEach(std::integer_sequence<int, N...>) {
+    ((firstUse<N>(), std::this_thread::sleep_for(std::chrono::microseconds(20))), ...);
+}
+
+void sitesRegisteredDuringADrainPrecedeTheirRecords() {
+
+    // a busy thread keeps the writer draining while new sites register
+    logging::BinaryLog& log = logging::BinaryLog::getInstance();
+    EXPECT_TRUE(log.start(log_path));
+
+    std::thread busy([]() {
+        for (int i = 0; i < 200000; ++i) {
+            BLOG(INFO, "busy {}", i);
+        }
+    });
+    firstUseOfEach(std::make_integer_sequence<int, 300>{});
+    busy.join();
+    log.stop();
+
+    std::vector<std::string> messages = decode(log_path);
+    EXPECT_TRUE(messages.size() >= 300);
+    EXPECT_EQ(0u, countUnknown(messages));
+}
+
+void aFullFileRotates() {
+
+    logging::BinaryLog& log = logging::BinaryLog::getInstance();
+    remove(rotated_log_path);
+    EXPECT_TRUE(log.start(log_path, 4096));
+    for (int i = 0; i < 2000; ++i) {
+        BLOG(INFO, "record {}", i);
+        if (i % 100 == 0) {
+            // let the writer keep up, the ring would drop records otherwise
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    log.stop();
+
+    std::vector<std::string> previous = decode(rotated_log_path);
+    std::vector<std::string> current = decode(log_path);
+    EXPECT_TRUE(!previous.empty());
+    EXPECT_TRUE(!current.empty());
+    EXPECT_EQ(0u, countUnknown(previous) + countUnknown(current));
+    if (!current.empty()) {
+        EXPECT_EQ(std::string("record 1999"), current.back());
+    }
+}
+
+int main(int argc, char** argv) {
+
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <binary_log_decode>\n";
+        return 2;
+    }
+    decoder_path = argv[1];
+
+    argumentsRoundTrip();
+    sitesRegisteredDuringADrainPrecedeTheirRecords();
+    aFullFileRotates();
+
+    return testFailures();
+}
@@ -0,0 +1,149 @@
+#include "ttm_json_encoder.h"
+#include "json_writer.h"
+#include "message_type.h"
+#include "stream_registry.h"
+#include "test_check.h"
+
+#include "nlohmann/json.hpp"
+
+#include <random>
+#include <string.h>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace Heartbeat = ParkingInfrastructure::Enablement::Streams::Vehicle::Heartbeat;
+namespace Request = ParkingInfrastructure::Routing::Streams::Vehicle::Request;
+using HeartbeatStream = BRIDGED_STREAM(Heartbeat);
+using RequestStream = BRIDGED_STREAM(Request);
+
+constexpr size_t message_capacity{128};
+constexpr int random_payloads{20000};
+
+// the json DOM encoding udpRecordToJSON() did before JsonWriter, the output must not change
+
+std::string domMessage(const Heartbeat::Payload& payload) {
+
+    json json_data = {};
+    json_data["msg_type"] = std::to_string(message_type::vehicle_heartbeat);
+    json_data["timestamp"] = std::to_string(payload.timestamp_ms);
+    json_data["veh_id"] = std::to_string(payload.vehicleId);
+    json_data["status"] = std::to_string(static_cast<uint8_t>(payload.vehicleStatus));
+    return json_data.dump();
+}
+
+std::string domMessage(const Request::Payload& payload) {
+
+    json json_data = {};
+    json_data["veh_id"] = std::to_string(199);
+    json_data["type"] = std::to_string(static_cast<uint8_t>(payload.requestType));
+    return json_data.dump();
+}
+
+template <typename Binding>
+PooledRecord* makeRecord(RecordPool& pool, const typename Binding::Payload& payload,
+                         uint16_t data_len = sizeof(typename Binding::Payload)) {
+
+    PooledRecord* record = pool.acquire(sizeof(payload));
+    memset(&record->header, 0, sizeof(record->header));
+    record->header.sourceInfo = static_cast<uint8_t>(Binding::source);
+    record->header.streamNumber = (uint8_t)Binding::number;
+    record->header.streamVersion = (uint8_t)Binding::version;
+    record->header.streamDataLen = data_len;
+    memcpy(record->payload(), &payload, sizeof(payload));
+    return record;
+}
+
+std::string encode(const PooledRecord& record, size_t capacity = message_capacity) {
+
+    char message[message_capacity];
+    size_t size = TtmJsonEncoder::encode(record, message, capacity);
+    return std::string(message, size);
+}
+
+template <typename Binding>
+bool encodesLikeTheDom(RecordPool& pool, const typename Binding::Payload& payload) {
+
+    PooledRecord* record = makeRecord<Binding>(pool, payload);
+    bool identical = encode(*record) == domMessage(payload);
+    if (!identical) {
+        std::cerr << "JsonWriter: " << encode(*record) << "\njson DOM:   " << domMessage(payload) << "\n";
+    }
+    pool.release(record);
+    return identical;
+}
+
+Heartbeat::Payload heartbeat(uint64_t timestamp_ms, uint64_t vehicle_id, uint8_t status) {
+
+    Heartbeat::Payload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.timestamp_ms = timestamp_ms;
+    payload.vehicleId = vehicle_id;
+    payload.vehicleStatus = static_cast<ParkingInfrastructure::Enablement::Types::VehicleStatus_e>(status);
+    return payload;
+}
+
+Request::Payload request(uint64_t timestamp_ms, uint8_t type) {
+
+    Request::Payload payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.timestamp_ms = timestamp_ms;
+    payload.requestType = static_cast<ParkingInfrastructure::Routing::Types::RequestType_e>(type);
+    return payload;
+}
+
+void bridgedStreamsMatchTheDomOutput() {
+
+    RecordPool pool(4);
+
+    EXPECT_TRUE((encodesLikeTheDom<HeartbeatStream>(pool, heartbeat(0, 0, 0))));
+    EXPECT_TRUE((encodesLikeTheDom<HeartbeatStream>(pool, heartbeat(UINT64_MAX, UINT64_MAX, UINT8_MAX))));
+    EXPECT_TRUE((encodesLikeTheDom<RequestStream>(pool, request(0, 0))));
+    EXPECT_TRUE((encodesLikeTheDom<RequestStream>(pool, request(UINT64_MAX, UINT8_MAX))));
+
+    std::mt19937_64 random(20261017);
+    int mismatches = 0;
+    for (int i = 0; i < random_payloads; ++i) {
+        // every digit count from 1 to 20
+        uint64_t timestamp_ms = random() >> (random() % 64);
+        uint64_t vehicle_id = random() >> (random() % 64);
+        uint8_t value = (uint8_t)random();
+
+        mismatches += !encodesLikeTheDom<HeartbeatStream>(pool, heartbeat(timestamp_ms, vehicle_id, value));
+        mismatches += !encodesLikeTheDom<RequestStream>(pool, request(timestamp_ms, value));
+    }
+    EXPECT_EQ(0, mismatches);
+}
+
+void unbridgedAndOversizedRecordsAreNotEncoded() {
+
+    RecordPool pool(4);
+    Heartbeat::Payload payload = heartbeat(UINT64_MAX, UINT64_MAX, 1);
+
+    PooledRecord* record = makeRecord<HeartbeatStream>(pool, payload);
+    record->header.streamVersion += 1;
+    EXPECT_TRUE(TtmJsonEncoder::streamName(record->header) == nullptr);
+    EXPECT_EQ(0u, encode(*record).size());
+    pool.release(record);
+
+    record = makeRecord<HeartbeatStream>(pool, payload, sizeof(payload) - 1);
+    EXPECT_EQ(0u, encode(*record).size());
+    pool.release(record);
+
+    // a message that does not fit is dropped whole, never cut short
+    record = makeRecord<HeartbeatStream>(pool, payload);
+    size_t message_size = domMessage(payload).size();
+    EXPECT_EQ(message_size, encode(*record, message_size).size());
+    EXPECT_EQ(0u, encode(*record, message_size - 1).size());
+    // the longest message still fits a 128 byte slot of the tx batch
+    EXPECT_TRUE(message_size <= message_capacity);
+    pool.release(record);
+}
+
+int main() {
+
+    bridgedStreamsMatchTheDomOutput();
+    unbridgedAndOversizedRecordsAreNotEncoded();
+
+    return testFailures();
+}
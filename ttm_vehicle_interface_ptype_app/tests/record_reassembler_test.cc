@@ -0,0 +1,134 @@
+#include "record_reassembler.h"
+#include "test_check.h"
+
+#include <string.h>
+#include <vector>
+
+constexpr uint8_t chunked_stream{140};
+constexpr uint8_t chunk_count{3};
+constexpr size_t last_chunk_size{100};
+constexpr size_t record_size{(chunk_count - 1) * UDP_RECORD_CHUNK_SIZE + last_chunk_size};
+
+/// payload byte at offset of the record with ref_index, so a misplaced chunk shows
+unsigned char payloadByte(uint32_t ref_index, size_t offset) {
+    return (unsigned char)(offset * 7 + ref_index);
+}
+
+struct Chunk {
+    UDPRecord_Header header;
+    std::vector<unsigned char> payload;
+};
+
+Chunk makeChunk(uint32_t ref_index, uint8_t chunk_index) {
+
+    Chunk chunk;
+    memset(&chunk.header, 0, sizeof(chunk.header));
+    chunk.header.sourceInfo = 3;
+    chunk.header.streamNumber = chunked_stream;
+    chunk.header.streamRefIndex = ref_index;
+    chunk.header.streamChunks = chunk_count;
+    chunk.header.streamChunkIdx = chunk_index;
+
+    size_t offset = (size_t)chunk_index * UDP_RECORD_CHUNK_SIZE;
+    size_t size = chunk_index == chunk_count - 1 ? last_chunk_size : UDP_RECORD_CHUNK_SIZE;
+    chunk.header.streamDataLen = (uint16_t)size;
+    for (size_t i = 0; i < size; ++i) {
+        chunk.payload.push_back(payloadByte(ref_index, offset + i));
+    }
+    return chunk;
+}
+
+const UDPRecordBuffer_t* add(RecordReassembler& reassembler, uint32_t ref_index, uint8_t chunk_index,
+                             uint64_t now_ms = 0) {
+
+    Chunk chunk = makeChunk(ref_index, chunk_index);
+    return reassembler.add(chunk.header, chunk.payload.data(), now_ms);
+}
+
+bool isWholeRecord(const UDPRecordBuffer_t* record, uint32_t ref_index) {
+
+    if (!record || record->header.streamRefIndex != ref_index || record->header.streamDataLen != record_size ||
+        record->header.streamChunks != 0 || record->header.streamChunkIdx != 0) {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < record_size; ++offset) {
+        if (record->payload[offset] != payloadByte(ref_index, offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void chunksOutOfOrderMakeTheWholeRecord() {
+
+    RecordReassembler reassembler(metrics::Direction::MABX_TO_TTM);
+    EXPECT_TRUE(add(reassembler, 1, 2) == nullptr);
+    EXPECT_TRUE(add(reassembler, 1, 0) == nullptr);
+    EXPECT_TRUE(isWholeRecord(add(reassembler, 1, 1), 1));
+    EXPECT_EQ(0u, reassembler.dropped());
+}
+
+void duplicateChunksAreIgnored() {
+
+    RecordReassembler reassembler(metrics::Direction::MABX_TO_TTM);
+    EXPECT_TRUE(add(reassembler, 1, 0) == nullptr);
+    EXPECT_TRUE(add(reassembler, 1, 0) == nullptr);
+    EXPECT_TRUE(add(reassembler, 1, 1) == nullptr);
+    EXPECT_TRUE(isWholeRecord(add(reassembler, 1, 2), 1));
+    EXPECT_EQ(0u, reassembler.dropped());
+}
+
+void aNewerSeriesSupersedesTheIncompleteOne() {
+
+    RecordReassembler reassembler(metrics::Direction::MABX_TO_TTM);
+    EXPECT_TRUE(add(reassembler, 1, 0) == nullptr);
+    EXPECT_TRUE(add(reassembler, 1, 1) == nullptr);
+
+    EXPECT_TRUE(add(reassembler, 2, 0) == nullptr);
+    EXPECT_EQ(1u, reassembler.dropped());
+    EXPECT_TRUE(add(reassembler, 2, 1) == nullptr);
+    EXPECT_TRUE(isWholeRecord(add(reassembler, 2, 2), 2));
+}
+
+void anIncompleteSeriesTimesOut() {
+
+    RecordReassembler reassembler(metrics::Direction::MABX_TO_TTM);
+    reassembler.setTimeout(chunked_stream, 50);
+
+    EXPECT_TRUE(add(reassembler, 1, 0, 0) == nullptr);
+    EXPECT_TRUE(add(reassembler, 1, 1, 10) == nullptr);
+    // past the deadline the series is dropped, its last chunk alone starts a new one
+    EXPECT_TRUE(add(reassembler, 1, 2, 60) == nullptr);
+    EXPECT_EQ(1u, reassembler.dropped());
+
+    EXPECT_TRUE(add(reassembler, 1, 0, 70) == nullptr);
+    EXPECT_TRUE(isWholeRecord(add(reassembler, 1, 1, 80), 1));
+}
+
+void malformedChunksAreRejected() {
+
+    RecordReassembler reassembler(metrics::Direction::MABX_TO_TTM);
+
+    Chunk chunk = makeChunk(1, 0);
+    chunk.header.streamChunkIdx = chunk_count;
+    EXPECT_TRUE(reassembler.add(chunk.header, chunk.payload.data(), 0) == nullptr);
+
+    // only the last chunk may be short, anything else would land at the wrong offset
+    chunk = makeChunk(1, 0);
+    chunk.header.streamDataLen = last_chunk_size;
+    EXPECT_TRUE(reassembler.add(chunk.header, chunk.payload.data(), 0) == nullptr);
+
+    EXPECT_EQ(2u, reassembler.dropped());
+}
+
+int main() {
+
+    chunksOutOfOrderMakeTheWholeRecord();
+    duplicateChunksAreIgnored();
+    aNewerSeriesSupersedesTheIncompleteOne();
+    anIncompleteSeriesTimesOut();
+    malformedChunksAreRejected();
+
+    return testFailures();
+}
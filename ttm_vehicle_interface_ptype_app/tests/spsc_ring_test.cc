@@ -0,0 +1,98 @@
+#include "spsc_ring.h"
+#include "test_check.h"
+
+#include <thread>
+
+using Ring = SpscRing<int>;
+
+void dropNewestRejectsIntoAFullRing() {
+
+    Ring ring(4, OverflowPolicy::DROP_NEWEST);
+    for (int i = 1; i <= 4; ++i) {
+        EXPECT_TRUE(ring.push(i) == Ring::PushResult::PUSHED);
+    }
+
+    EXPECT_TRUE(ring.push(5) == Ring::PushResult::REJECTED);
+    EXPECT_EQ(1u, ring.dropped());
+    EXPECT_EQ(4u, ring.size());
+
+    int value = 0;
+    for (int i = 1; i <= 4; ++i) {
+        EXPECT_TRUE(ring.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(!ring.pop(value));
+}
+
+void dropOldestEvictsTheHead() {
+
+    Ring ring(4, OverflowPolicy::DROP_OLDEST);
+    for (int i = 1; i <= 4; ++i) {
+        ring.push(i);
+    }
+
+    int evicted = 0;
+    EXPECT_TRUE(ring.push(5, &evicted) == Ring::PushResult::EVICTED_OLDEST);
+    EXPECT_EQ(1, evicted);
+    EXPECT_TRUE(ring.push(6, &evicted) == Ring::PushResult::EVICTED_OLDEST);
+    EXPECT_EQ(2, evicted);
+    EXPECT_EQ(2u, ring.dropped());
+
+    int values[8];
+    EXPECT_EQ(4u, ring.pop(values, 8));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(i + 3, values[i]);
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+void capacityRoundsUpToAPowerOfTwo() {
+
+    Ring ring(5);
+    EXPECT_EQ(8u, ring.capacity());
+}
+
+void dropOldestKeepsOrderUnderContention() {
+
+    // the producer evicts while the consumer pops: every value comes out at most once, in order,
+    // and each one pushed was either popped or counted as dropped
+    constexpr int pushes{200000};
+    Ring ring(64, OverflowPolicy::DROP_OLDEST);
+
+    std::thread producer([&ring]() {
+        for (int i = 0; i < pushes; ++i) {
+            ring.push(i);
+        }
+    });
+
+    int popped = 0;
+    int last = -1;
+    bool ordered = true;
+    int value = 0;
+    while (true) {
+        if (ring.pop(value)) {
+            ordered &= value > last;
+            last = value;
+            ++popped;
+            continue;
+        }
+        if (last == pushes - 1) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    producer.join();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ((uint64_t)pushes, popped + ring.dropped());
+}
+
+int main() {
+
+    dropNewestRejectsIntoAFullRing();
+    dropOldestEvictsTheHead();
+    capacityRoundsUpToAPowerOfTwo();
+    dropOldestKeepsOrderUnderContention();
+
+    return testFailures();
+}
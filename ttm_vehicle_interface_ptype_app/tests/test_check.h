@@ -0,0 +1,34 @@
+#pragma once
+
+#include <iostream>
+
+///
+/// @brief Minimal checks for the unit tests, each test is a plain executable run by ctest.
+///
+/// A failed check prints its location and lets the test go on; main() returns testFailures(),
+/// so any failure fails the ctest run.
+///
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define EXPECT_TRUE(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " << #condition << "\n"; \
+            ++testFailures(); \
+        } \
+    } while (0)
+
+#define EXPECT_EQ(expected, actual) \
+    do { \
+        const auto& test_expected = (expected); \
+        const auto& test_actual = (actual); \
+        if (!(test_expected == test_actual)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " << #actual << " == " << test_expected \
+                      << ", got " << test_actual << "\n"; \
+            ++testFailures(); \
+        } \
+    } while (0)
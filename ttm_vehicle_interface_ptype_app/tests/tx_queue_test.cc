@@ -0,0 +1,163 @@
+#include "tx_queue.h"
+#include "test_check.h"
+#include "metrics/monotonic_clock.h"
+
+#include <memory>
+#include <vector>
+
+constexpr uint8_t high_stream{5};
+constexpr uint8_t normal_stream{1};
+constexpr uint8_t low_stream{11};
+constexpr uint8_t state_stream{7};
+constexpr uint8_t aging_stream{9};
+
+PooledRecord* makeRecord(TxQueue& queue, uint8_t stream_number, uint32_t ref_index, uint64_t received_ns = 0) {
+
+    PooledRecord* record = queue.acquire(16);
+    record->header.streamNumber = stream_number;
+    record->header.streamRefIndex = ref_index;
+    record->header.streamDataLen = 16;
+    record->received_ns = received_ns;
+    return record;
+}
+
+std::vector<PooledRecord*> popAll(TxQueue& queue, size_t max_count) {
+
+    std::vector<PooledRecord*> records(max_count);
+    records.resize(queue.pop(records.data(), max_count));
+    return records;
+}
+
+void releaseAll(TxQueue& queue, const std::vector<PooledRecord*>& records) {
+
+    for (PooledRecord* record : records) {
+        queue.release(record);
+    }
+}
+
+std::unique_ptr<TxQueue> makePriorityQueue() {
+
+    auto queue = std::make_unique<TxQueue>(64, metrics::Direction::MABX_TO_TTM);
+    queue->setStreamPriority(high_stream, TxPriority::HIGH);
+    queue->setStreamPriority(low_stream, TxPriority::LOW);
+    return queue;
+}
+
+void strictServesHigherPrioritiesFirst() {
+
+    auto queue = makePriorityQueue();
+    queue->push(makeRecord(*queue, low_stream, 0));
+    queue->push(makeRecord(*queue, normal_stream, 1));
+    queue->push(makeRecord(*queue, low_stream, 2));
+    queue->push(makeRecord(*queue, high_stream, 3));
+
+    auto records = popAll(*queue, 8);
+    EXPECT_EQ(4u, records.size());
+    const uint32_t expected[] = {3, 1, 0, 2};
+    for (size_t i = 0; i < records.size() && i < 4; ++i) {
+        EXPECT_EQ(expected[i], records[i]->header.streamRefIndex);
+    }
+    releaseAll(*queue, records);
+}
+
+void weightedTakesEachPriorityByItsWeight() {
+
+    auto queue = makePriorityQueue();
+    queue->setScheduling(TxScheduling::WEIGHTED, {{2, 1, 1}});
+    for (uint32_t i = 0; i < 6; ++i) {
+        queue->push(makeRecord(*queue, high_stream, i));
+    }
+    for (uint32_t i = 0; i < 6; ++i) {
+        queue->push(makeRecord(*queue, low_stream, 100 + i));
+    }
+
+    auto records = popAll(*queue, 6);
+    EXPECT_EQ(6u, records.size());
+    const uint8_t expected[] = {high_stream, high_stream, low_stream, high_stream, high_stream, low_stream};
+    for (size_t i = 0; i < records.size() && i < 6; ++i) {
+        EXPECT_EQ((int)expected[i], (int)records[i]->header.streamNumber);
+    }
+    releaseAll(*queue, records);
+}
+
+void latestValueKeepsOnlyTheNewestRecord() {
+
+    TxQueue queue(64, metrics::Direction::MABX_TO_TTM);
+    EXPECT_TRUE(queue.setStreamPolicy(state_stream, QueuePolicy::LATEST_VALUE));
+    queue.push(makeRecord(queue, normal_stream, 1));
+    for (uint32_t i = 10; i < 13; ++i) {
+        queue.push(makeRecord(queue, state_stream, i));
+    }
+
+    auto records = popAll(queue, 8);
+    EXPECT_EQ(2u, records.size());
+    if (records.size() == 2) {
+        // the pending state update goes ahead of the FIFO records of its priority
+        EXPECT_EQ(12u, records[0]->header.streamRefIndex);
+        EXPECT_EQ(1u, records[1]->header.streamRefIndex);
+    }
+    EXPECT_EQ(2u, queue.coalesced());
+    releaseAll(queue, records);
+}
+
+void expiredRecordsAreDroppedAtPop() {
+
+    TxQueue queue(64, metrics::Direction::MABX_TO_TTM);
+    queue.setStreamMaxAge(aging_stream, 50);
+    uint64_t now_ns = metrics::monotonicNowNs();
+    uint64_t stale_ns = now_ns - 100 * 1000000ULL;
+
+    // a whole batch of stale records must not hide the fresh one behind it
+    for (uint32_t i = 0; i < 4; ++i) {
+        queue.push(makeRecord(queue, aging_stream, i, stale_ns));
+    }
+    queue.push(makeRecord(queue, aging_stream, 4, now_ns));
+    queue.push(makeRecord(queue, normal_stream, 5, stale_ns));
+
+    auto records = popAll(queue, 2);
+    EXPECT_EQ(2u, records.size());
+    if (records.size() == 2) {
+        EXPECT_EQ(4u, records[0]->header.streamRefIndex);
+        // streams without a max age are sent however old
+        EXPECT_EQ(5u, records[1]->header.streamRefIndex);
+    }
+    EXPECT_EQ(4u, queue.expired());
+    EXPECT_TRUE(queue.empty());
+    releaseAll(queue, records);
+}
+
+void priorityRingsShareTheCapacity() {
+
+    auto queue = std::make_unique<TxQueue>(1024, metrics::Direction::MABX_TO_TTM);
+    queue->setStreamPriority(high_stream, TxPriority::HIGH);
+    queue->setStreamPriority(low_stream, TxPriority::LOW);
+    for (uint32_t i = 0; i < 1200; ++i) {
+        queue->push(makeRecord(*queue, high_stream, i));
+        queue->push(makeRecord(*queue, normal_stream, i));
+        queue->push(makeRecord(*queue, low_stream, i));
+    }
+
+    EXPECT_EQ(256u, queue->priorityStats(TxPriority::HIGH).depth);
+    EXPECT_EQ(512u, queue->priorityStats(TxPriority::NORMAL).depth);
+    EXPECT_EQ(256u, queue->priorityStats(TxPriority::LOW).depth);
+    EXPECT_EQ(3u * 1200 - 1024, queue->dropped());
+
+    // DROP_OLDEST kept the newest records
+    auto records = popAll(*queue, 1);
+    EXPECT_EQ(1u, records.size());
+    if (records.size() == 1) {
+        EXPECT_EQ(1200u - 256, records[0]->header.streamRefIndex);
+    }
+    releaseAll(*queue, records);
+}
+
+int main() {
+
+    strictServesHigherPrioritiesFirst();
+    weightedTakesEachPriorityByItsWeight();
+    latestValueKeepsOnlyTheNewestRecord();
+    expiredRecordsAreDroppedAtPop();
+    priorityRingsShareTheCapacity();
+
+    return testFailures();
+}